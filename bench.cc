@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "board.h"
+#include "level.h"
+#include "rules.h"
+#include "solve.h"
+#include "utils.h"
+
+using namespace std;
+
+static const Rules REAL_RULES = Rules("rules-real.csv");
+
+BenchResult::BenchResult()
+  : length(-2),
+    wall_ms(0),
+    nodes_per_sec(0),
+    peak_rss_kb(0),
+    num_moves(0),
+    num_expanded(0),
+    max_mem_state(0),
+    num_visited_states(0),
+    num_visited_hit_improve(0),
+    num_visited_hit_drop(0) {}
+
+// What a child process sends back.
+struct BenchRun {
+  int length;
+  double wall_ms;
+  long long stats[6];
+};
+
+template <class G>
+static void SolveOnGeometry(const Level& level, const SolveOptions& base,
+                            BenchRun* run) {
+  char bc[G::BOARD_SIZE + 1];
+  if (LevelToBoard<G>(level, bc) > G::MAX_TILES) return;
+  bc[G::BOARD_SIZE] = 0;
+  BasicBoard<G> b(bc, REAL_RULES);
+  BasicState<G> s(bc);
+  if (b.KeyWords(s) > MAX_KEY_WORDS) return;
+  SolveOptions options;
+  options.huge_pages = base.huge_pages;
+  options.visited_filter = base.visited_filter;
+  const long long start = NowMicros();
+  const BasicSolveResult<G> res = solve(b, s, options);
+  run->wall_ms = (NowMicros() - start) / 1000.0;
+  run->length = res.success ? res.end_state.GetHistoryLen() : -1;
+  run->stats[0] = res.num_moves;
+  run->stats[1] = res.num_expanded;
+  run->stats[2] = res.max_mem_state;
+  run->stats[3] = res.num_visited_states;
+  run->stats[4] = res.num_visited_hit_improve;
+  run->stats[5] = res.num_visited_hit_drop;
+}
+
+// Solves the level at path, length stays -2 if it is not a valid level.
+static void SolveFile(const string& path, const SolveOptions& options,
+                      BenchRun* run) {
+  Level level;
+  string error;
+  if (!ReadLevelFile(path, &level, &error)) return;
+  const int height = level.size();
+  const int width = level[0].size();
+#define TRY_GEOMETRY(G)                                       \
+  if (width + 2 <= G::BOARD_X && height + 2 <= G::BOARD_Y) {  \
+    SolveOnGeometry<G>(level, options, run);                  \
+    return;                                                   \
+  }
+  GTN_FOR_EACH_GEOMETRY(TRY_GEOMETRY)
+#undef TRY_GEOMETRY
+}
+
+BenchResult BenchLevel(const string& path, int runs,
+                       const SolveOptions& options) {
+  BenchResult result;
+  result.level = path;
+  for (int r = 0; r < runs; ++r) {
+    int fds[2];
+    if (pipe(fds) != 0) break;
+    const pid_t pid = fork();
+    if (pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      break;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      BenchRun run;
+      run.length = -2;
+      run.wall_ms = 0;
+      for (int i = 0; i < 6; ++i) run.stats[i] = 0;
+      SolveFile(path, options, &run);
+      const bool ok = write(fds[1], &run, sizeof(run)) == sizeof(run);
+      _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    BenchRun run;
+    const bool got = read(fds[0], &run, sizeof(run)) == sizeof(run);
+    close(fds[0]);
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !got ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0 || run.length == -2) {
+      result.length = -2;
+      break;
+    }
+    if (usage.ru_maxrss > result.peak_rss_kb) {
+      result.peak_rss_kb = usage.ru_maxrss;
+    }
+    if (r > 0 && run.wall_ms >= result.wall_ms) continue;
+    result.length = run.length;
+    result.wall_ms = run.wall_ms;
+    result.num_moves = run.stats[0];
+    result.num_expanded = run.stats[1];
+    result.max_mem_state = run.stats[2];
+    result.num_visited_states = run.stats[3];
+    result.num_visited_hit_improve = run.stats[4];
+    result.num_visited_hit_drop = run.stats[5];
+    result.nodes_per_sec =
+        run.wall_ms > 0 ? run.stats[1] * 1000.0 / run.wall_ms : 0;
+  }
+  return result;
+}
+
+string BenchCsvHeader() {
+  return "level,length,wall_ms,nodes_per_sec,peak_rss_kb,num_moves,"
+         "num_expanded,max_mem_state,num_visited_states,"
+         "num_visited_hit_improve,num_visited_hit_drop";
+}
+
+string BenchCsvLine(const BenchResult& r) {
+  char buf[512];
+  snprintf(buf, sizeof(buf), "%s,%d,%.3f,%.0f,%lld,%lld,%lld,%lld,%lld,%lld,%lld",
+           r.level.c_str(), r.length, r.wall_ms, r.nodes_per_sec,
+           r.peak_rss_kb, r.num_moves, r.num_expanded, r.max_mem_state,
+           r.num_visited_states, r.num_visited_hit_improve,
+           r.num_visited_hit_drop);
+  return buf;
+}
+
+// Fields of a csv line without the spaces around them.
+static vector<string> CsvFields(const string& line) {
+  vector<string> fields;
+  SplitString(line, ",", &fields);
+  for (size_t i = 0; i < fields.size(); ++i) {
+    const size_t begin = fields[i].find_first_not_of(' ');
+    const size_t end = fields[i].find_last_not_of(' ');
+    fields[i] = begin == string::npos ? ""
+                                      : fields[i].substr(begin, end - begin + 1);
+  }
+  return fields;
+}
+
+bool ReadBenchCsv(const string& path, map<string, BenchResult>* results) {
+  ifstream in(path.c_str());
+  if (!in) return false;
+  string line;
+  getline(in, line);
+  while (getline(in, line)) {
+    const vector<string> f = CsvFields(line);
+    if (f.size() < 11) continue;
+    BenchResult r;
+    r.level = f[0];
+    r.length = atoi(f[1].c_str());
+    r.wall_ms = atof(f[2].c_str());
+    r.nodes_per_sec = atof(f[3].c_str());
+    r.peak_rss_kb = atoll(f[4].c_str());
+    r.num_moves = atoll(f[5].c_str());
+    r.num_expanded = atoll(f[6].c_str());
+    r.max_mem_state = atoll(f[7].c_str());
+    r.num_visited_states = atoll(f[8].c_str());
+    r.num_visited_hit_improve = atoll(f[9].c_str());
+    r.num_visited_hit_drop = atoll(f[10].c_str());
+    (*results)[r.level] = r;
+  }
+  return true;
+}
+
+bool ReadResultLengths(const string& path, map<string, int>* lengths) {
+  ifstream in(path.c_str());
+  if (!in) return false;
+  string line;
+  getline(in, line);
+  while (getline(in, line)) {
+    const vector<string> f = CsvFields(line);
+    if (f.size() < 2 || f[1].empty()) continue;
+    (*lengths)[f[0]] = atoi(f[1].c_str());
+  }
+  return true;
+}
+
+vector<string> CompareBench(const vector<BenchResult>& results,
+                            const map<string, BenchResult>& baseline,
+                            const map<string, int>& lengths, double threshold,
+                            double min_ms) {
+  vector<string> regressions;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    const string prefix = r.level + ": ";
+    map<string, int>::const_iterator len = lengths.find(r.level);
+    // RESULTS.csv has 0 for levels without a solution.
+    if (len != lengths.end() && len->second != (r.length < 0 ? 0 : r.length)) {
+      regressions.push_back(prefix + "solution length " +
+                            to_string(r.length) + " instead of " +
+                            to_string(len->second));
+    }
+    map<string, BenchResult>::const_iterator base = baseline.find(r.level);
+    if (base == baseline.end()) continue;
+    const BenchResult& b = base->second;
+    if ((r.wall_ms >= min_ms || b.wall_ms >= min_ms) &&
+        r.wall_ms > b.wall_ms * (1 + threshold)) {
+      stringstream ss;
+      ss << prefix << "wall time " << r.wall_ms << "ms instead of "
+         << b.wall_ms << "ms";
+      regressions.push_back(ss.str());
+    }
+    if (b.peak_rss_kb > 0 && r.peak_rss_kb > b.peak_rss_kb * (1 + threshold)) {
+      stringstream ss;
+      ss << prefix << "peak RSS " << r.peak_rss_kb << "KB instead of "
+         << b.peak_rss_kb << "KB";
+      regressions.push_back(ss.str());
+    }
+  }
+  return regressions;
+}
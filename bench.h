@@ -0,0 +1,54 @@
+#ifndef _GTN_BENCH_H__
+#define _GTN_BENCH_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "solve.h"
+
+// Measurements of solving one level, best of the runs.
+struct BenchResult {
+  BenchResult();
+  std::string level;
+  // -1 if there is no solution, -2 if the level couldn't be solved at all.
+  int length;
+  double wall_ms;
+  double nodes_per_sec;
+  long long peak_rss_kb;
+  // SolveResult stats.
+  long long num_moves;
+  long long num_expanded;
+  long long max_mem_state;
+  long long num_visited_states;
+  long long num_visited_hit_improve;
+  long long num_visited_hit_drop;
+};
+
+// Solves the level file at path runs times, each in a child process so that
+// the peak RSS is the level's own. Keeps the best wall time. Only the
+// huge_pages and visited_filter of options are used.
+BenchResult BenchLevel(const std::string& path, int runs,
+                       const SolveOptions& options = SolveOptions());
+
+std::string BenchCsvHeader();
+std::string BenchCsvLine(const BenchResult& result);
+// Reads a file of BenchCsvLine()s after a header, by level. Returns false if
+// it can't be read.
+bool ReadBenchCsv(const std::string& path,
+                  std::map<std::string, BenchResult>* results);
+
+// Solution lengths of a RESULTS.csv file by level.
+bool ReadResultLengths(const std::string& path,
+                       std::map<std::string, int>* lengths);
+
+// One message per regression of results: a wall time or peak RSS more than
+// threshold (0.2 is 20%) over baseline, ignoring wall times of both under
+// min_ms, or a solution length different from lengths.
+std::vector<std::string> CompareBench(
+    const std::vector<BenchResult>& results,
+    const std::map<std::string, BenchResult>& baseline,
+    const std::map<std::string, int>& lengths, double threshold,
+    double min_ms);
+
+#endif // _GTN_BENCH_H__
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+using namespace std;
+
+// solve_bench [-n runs] [-o out.csv] [-b baseline.csv] [-r RESULTS.csv]
+//             [-t threshold] [-m min_ms] [-H] [-F] level...
+// Solves each level file, best of runs, and writes the measurements as csv to
+// out.csv or stdout. -H puts the visited states on huge pages, -F puts a
+// Bloom filter in front of them. Exits with 1 if a level regressed against
+// the baseline or its solution length differs from RESULTS.csv.
+int main(int argc, char **argv) {
+  int runs = 3;
+  string out_path;
+  string baseline_path;
+  string results_path = "RESULTS.csv";
+  double threshold = 0.5;
+  double min_ms = 10;
+  SolveOptions options;
+  vector<string> levels;
+  for (int i = 1; i < argc; ++i) {
+    const bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "-n") == 0 && has_value) {
+      runs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0 && has_value) {
+      out_path = argv[++i];
+    } else if (strcmp(argv[i], "-b") == 0 && has_value) {
+      baseline_path = argv[++i];
+    } else if (strcmp(argv[i], "-r") == 0 && has_value) {
+      results_path = argv[++i];
+    } else if (strcmp(argv[i], "-t") == 0 && has_value) {
+      threshold = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-m") == 0 && has_value) {
+      min_ms = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-H") == 0) {
+      options.huge_pages = true;
+    } else if (strcmp(argv[i], "-F") == 0) {
+      options.visited_filter = true;
+    } else {
+      levels.push_back(argv[i]);
+    }
+  }
+  if (levels.empty() || runs < 1) {
+    cout << "Usage: solve_bench [-n runs] [-o out.csv] [-b baseline.csv] "
+         << "[-r RESULTS.csv] [-t threshold] [-m min_ms] [-H] [-F] level..."
+         << endl;
+    exit(2);
+  }
+  map<string, BenchResult> baseline;
+  if (!baseline_path.empty() && !ReadBenchCsv(baseline_path, &baseline)) {
+    cout << "Can't read baseline " << baseline_path << endl;
+    exit(3);
+  }
+  map<string, int> lengths;
+  if (!results_path.empty()) ReadResultLengths(results_path, &lengths);
+
+  ofstream out_file;
+  if (!out_path.empty()) {
+    out_file.open(out_path.c_str());
+    if (!out_file) {
+      cout << "Can't write " << out_path << endl;
+      exit(3);
+    }
+  }
+  ostream& out = out_path.empty() ? cout : out_file;
+  out << BenchCsvHeader() << endl;
+  vector<BenchResult> results;
+  double total_ms = 0;
+  for (size_t i = 0; i < levels.size(); ++i) {
+    results.push_back(BenchLevel(levels[i], runs, options));
+    out << BenchCsvLine(results.back()) << endl;
+    total_ms += results.back().wall_ms;
+    if (results.back().length == -2) {
+      cerr << levels[i] << ": can't solve" << endl;
+    }
+  }
+  cerr << levels.size() << " levels, " << total_ms << "ms" << endl;
+
+  const vector<string> regressions =
+      CompareBench(results, baseline, lengths, threshold, min_ms);
+  for (size_t i = 0; i < regressions.size(); ++i) {
+    cerr << "REGRESSION " << regressions[i] << endl;
+  }
+  return regressions.empty() ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include <unistd.h>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+static const char CSV_PATH[] = "/tmp/gtn_bench_test.csv";
+
+TEST(TestBench, BenchLevel) {
+  const BenchResult r = BenchLevel("levels/P1L01", 2);
+  EXPECT_EQ("levels/P1L01", r.level);
+  EXPECT_EQ(4, r.length);
+  EXPECT_EQ(59, r.num_moves);
+  EXPECT_EQ(10, r.num_visited_states);
+  EXPECT_LT(0, r.num_expanded);
+  EXPECT_LT(0, r.peak_rss_kb);
+  EXPECT_EQ(-2, BenchLevel("levels/nonexistent", 1).length);
+}
+
+TEST(TestBench, Csv) {
+  BenchResult r;
+  r.level = "levels/P1L01";
+  r.length = 4;
+  r.wall_ms = 1.5;
+  r.peak_rss_kb = 3000;
+  r.num_visited_hit_drop = 44;
+  {
+    ofstream out(CSV_PATH);
+    out << BenchCsvHeader() << endl << BenchCsvLine(r) << endl;
+  }
+  map<string, BenchResult> results;
+  ASSERT_TRUE(ReadBenchCsv(CSV_PATH, &results));
+  ASSERT_EQ(1, results.size());
+  const BenchResult& read = results["levels/P1L01"];
+  EXPECT_EQ(4, read.length);
+  EXPECT_DOUBLE_EQ(1.5, read.wall_ms);
+  EXPECT_EQ(3000, read.peak_rss_kb);
+  EXPECT_EQ(44, read.num_visited_hit_drop);
+  unlink(CSV_PATH);
+  EXPECT_FALSE(ReadBenchCsv(CSV_PATH, &results));
+
+  map<string, int> lengths;
+  ASSERT_TRUE(ReadResultLengths("RESULTS.csv", &lengths));
+  EXPECT_EQ(4, lengths["levels/P1L01"]);
+  EXPECT_EQ(26, lengths["levels/P4L30"]);
+}
+
+TEST(TestBench, Compare) {
+  BenchResult base;
+  base.level = "a";
+  base.length = 5;
+  base.wall_ms = 100;
+  base.peak_rss_kb = 1000;
+  map<string, BenchResult> baseline;
+  baseline["a"] = base;
+  map<string, int> lengths;
+  lengths["a"] = 5;
+  vector<BenchResult> results(1, base);
+  results[0].wall_ms = 115;
+  results[0].peak_rss_kb = 1100;
+  EXPECT_TRUE(CompareBench(results, baseline, lengths, 0.2, 5).empty());
+  results[0].wall_ms = 130;
+  ASSERT_EQ(1, CompareBench(results, baseline, lengths, 0.2, 5).size());
+  EXPECT_EQ("a: wall time 130ms instead of 100ms",
+            CompareBench(results, baseline, lengths, 0.2, 5)[0]);
+  // Both regressions of a level are reported.
+  results[0].peak_rss_kb = 1500;
+  ASSERT_EQ(2, CompareBench(results, baseline, lengths, 0.2, 5).size());
+  EXPECT_EQ("a: peak RSS 1500KB instead of 1000KB",
+            CompareBench(results, baseline, lengths, 0.2, 5)[1]);
+  results[0].wall_ms = 100;
+  EXPECT_EQ(1, CompareBench(results, baseline, lengths, 0.2, 5).size());
+  results[0].peak_rss_kb = 1000;
+  results[0].length = 6;
+  EXPECT_EQ("a: solution length 6 instead of 5",
+            CompareBench(results, baseline, lengths, 0.2, 5)[0]);
+  // Short levels are noise.
+  baseline["a"].wall_ms = 1;
+  results[0].length = 5;
+  results[0].wall_ms = 3;
+  EXPECT_TRUE(CompareBench(results, baseline, lengths, 0.2, 5).empty());
+}
@@ -0,0 +1,81 @@
+#ifndef _GTN_BLOOM_H__
+#define _GTN_BLOOM_H__
+
+#include <new>
+
+#include "pages.h"
+
+// Bloom filter over 64 bit hashes, blocked: all the bits of a hash are in
+// one 64 byte block, so a lookup touches one cache line. MayContain() is
+// false only for hashes never added.
+class BlockedBloomFilter {
+ public:
+  // Bits per expected hash. With BITS_SET bits in 512 bit blocks about 1 in
+  // 200 new hashes is a false positive at the expected count.
+  static const int BITS_PER_KEY = 16;
+  static const int BITS_SET = 6;
+
+  BlockedBloomFilter() : num_blocks(0), shift(64) {}
+
+  // Drops the hashes and makes room for about num_keys. Throws
+  // std::bad_alloc, keeping the hashes, if the memory can't be mapped.
+  void Reset(long long num_keys, bool huge_pages) {
+    size_t blocks = 1;
+    while ((long long)blocks * BLOCK_BITS < num_keys * BITS_PER_KEY) {
+      blocks *= 2;
+    }
+    PageBuffer fresh;
+    if (!fresh.Allocate(blocks * sizeof(Block), huge_pages)) {
+      throw std::bad_alloc();
+    }
+    buffer.Swap(&fresh);
+    num_blocks = blocks;
+    shift = 64;
+    for (size_t b = blocks; b > 1; b /= 2) --shift;
+  }
+
+  long long Bytes() const { return (long long)num_blocks * sizeof(Block); }
+
+  void Prefetch(unsigned long long hash) const {
+    __builtin_prefetch(&blocks()[BlockIndex(hash)]);
+  }
+
+  void Add(unsigned long long hash) {
+    unsigned long long* w = blocks()[BlockIndex(hash)].w;
+    for (int i = 0; i < BITS_SET; ++i, hash >>= 9) {
+      w[(hash >> 6) & 7] |= 1ULL << (hash & 63);
+    }
+  }
+
+  bool MayContain(unsigned long long hash) const {
+    const unsigned long long* w = blocks()[BlockIndex(hash)].w;
+    for (int i = 0; i < BITS_SET; ++i, hash >>= 9) {
+      if (!(w[(hash >> 6) & 7] & (1ULL << (hash & 63)))) return false;
+    }
+    return true;
+  }
+
+ private:
+  static const int BLOCK_BITS = 512;
+
+  struct Block {
+    unsigned long long w[8];
+  };
+
+  Block* blocks() const { return (Block*)buffer.data(); }
+
+  // The bits come from the low bits of hash, the block from a remix of it.
+  size_t BlockIndex(unsigned long long hash) const {
+    if (shift == 64) return 0;
+    return ((hash ^ (hash >> 31)) * 0xC2B2AE3D27D4EB4FULL) >> shift;
+  }
+
+  PageBuffer buffer;
+  size_t num_blocks;
+  int shift;
+
+  BlockedBloomFilter(const BlockedBloomFilter&);
+  BlockedBloomFilter& operator=(const BlockedBloomFilter&);
+};
+
+#endif // _GTN_BLOOM_H__
@@ -0,0 +1,54 @@
+#include <new>
+
+#include "bloom.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+// Well spread hashes, as VisitedTable passes.
+static unsigned long long Mix(unsigned long long i) {
+  i = (i ^ (i >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  i = (i ^ (i >> 27)) * 0x94D049BB133111EBULL;
+  return i ^ (i >> 31);
+}
+
+TEST(TestBloom, NoFalseNegatives) {
+  BlockedBloomFilter filter;
+  filter.Reset(10000, false);
+  // Rounded up to a power of 2 of blocks.
+  const long long bytes = 10000 * BlockedBloomFilter::BITS_PER_KEY / 8;
+  EXPECT_LE(bytes, filter.Bytes());
+  EXPECT_GT(2 * bytes, filter.Bytes());
+  EXPECT_FALSE(filter.MayContain(Mix(1)));
+  for (int i = 0; i < 10000; ++i) filter.Add(Mix(i));
+  for (int i = 0; i < 10000; ++i) ASSERT_TRUE(filter.MayContain(Mix(i)));
+  int false_positives = 0;
+  for (int i = 10000; i < 110000; ++i) {
+    false_positives += filter.MayContain(Mix(i));
+  }
+  // About 0.5% at the expected count.
+  EXPECT_LT(false_positives, 2000);
+  // Reset() drops the hashes.
+  filter.Reset(10, false);
+  EXPECT_FALSE(filter.MayContain(Mix(1)));
+}
+
+TEST(TestBloom, OneBlock) {
+  BlockedBloomFilter filter;
+  filter.Reset(1, false);
+  EXPECT_EQ(64, filter.Bytes());
+  filter.Add(Mix(5));
+  filter.Prefetch(Mix(5));
+  EXPECT_TRUE(filter.MayContain(Mix(5)));
+}
+
+TEST(TestBloom, OutOfMemory) {
+  BlockedBloomFilter filter;
+  filter.Reset(1000, false);
+  for (int i = 0; i < 1000; ++i) filter.Add(Mix(i));
+  // 128TB, more than the address space.
+  EXPECT_THROW(filter.Reset(1LL << 50, false), std::bad_alloc);
+  EXPECT_EQ(2048, filter.Bytes());
+  for (int i = 0; i < 1000; ++i) ASSERT_TRUE(filter.MayContain(Mix(i)));
+}
@@ -1,9 +1,17 @@
+#include <algorithm>
+#include <assert.h>
 #include <cstdlib>
 #include <iostream>
 #include <queue>
 #include <sstream>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
+#ifdef __SSE2__
+#include <immintrin.h>
+#define GTN_X86 1
+#endif
 
 #include "board.h"
 #include "convert.h"
@@ -14,29 +22,109 @@ using namespace std;
 
 static const int INFINITY = 1000;
 
+const int MOVEABLE[] = {
+  0,  // "ACG";
+  1,  // "SQR";
+  1,  // "HOG";
+  1,  // "MSE";
+  0,  // "ACN";
+  1,  // "WLF";
+  1,  // "BER";
+  0,  // "TPP";
+  1,  // "ALG";
+  0,  // "SWM";
+  0,  // "MSS";
+  0,  // "HOS";
+  1,  // "SNK";
+  1,  // "PRC";
+  0,  // "FSN";
+  0,  // "---";
+};
+
+// Bits of a static slot in State::Hash().
+static const int STATIC_BITS = TYPE_BITS;
+static const int SQUIRREL = TriToCode("SQR") - 'a';
+static const int GOLDEN_ACORN = TriToCode("ACG") - 'a';
+
+// static_slot of the cells of irrelevant tiles.
+static const int IRRELEVANT = -2;
+// Static slot code for "nothing immovable here".
+static const int STATIC_EMPTY = (1 << STATIC_BITS) - 1;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Board
 ////////////////////////////////////////////////////////////////////////////////
 
-Board::Board(const char *p, const Rules& rules_) : rules(rules_) {
+template <class G>
+BasicBoard<G>::BasicBoard(const char *p, const Rules& rules_)
+    : rules(rules_), slide_cache_lookups(0), slide_cache_hits(0) {
   int acg_pos = -1;
   for (int i = 0; i < BOARD_Y * BOARD_X; ++i) {
     const char c = p[i];
     b[i] = c == '#' ? '#' : BLANK;
     if (c == TriToCode("ACG")) acg_pos = i;
+    open_cells[i] = b[i] == BLANK;
+  }
+  for (int i = 0; i < BOARD_Y * BOARD_X; ++i) {
+    if (p[i] != TriToCode("ACG")) continue;
+    for (int di = 0; di < 4; ++di) {
+      const int pos = i + State::DIRECTIONS[di];
+      if (b[pos] == BLANK) goal_cells[pos] = true;
+    }
+  }
+  ComputeTransitions();
+  ComputeRelevance(p);
+  num_static = 0;
+  for (int i = 0; i < BOARD_Y * BOARD_X; ++i) {
+    const char c = p[i];
+    static_slot[i] = irrelevant[i] ? IRRELEVANT : -1;
+    if (c >= 'a' && c < TriToCode("---") && !MOVEABLE[c - 'a'] &&
+        !irrelevant[i] && num_static < MAX_TILES) {
+      static_slot[i] = num_static;
+      static_pos[num_static++] = i;
+    }
   }
   ComputeDistances(acg_pos);
+  ComputeSlides();
+}
+
+template <class G>
+void BasicBoard<G>::ComputeSlides() {
+  for (int pos = 0; pos < BOARD_SIZE; ++pos) {
+    for (int dir = 0; dir < 4; ++dir) {
+      slide_lookups[pos][dir].reset();
+      slide_end[pos][dir] = pos;
+      if (b[pos] != BLANK) continue;
+      // As in State::Move(): the cells ahead and to the sides of each cell
+      // the tile lands on, starting with pos. The cell it is on was ahead of
+      // the one before.
+      int curr = pos;
+      while (true) {
+        for (int i = 1; i < 4; ++i) {
+          const int lookup = curr + State::DIR_LOOKUP[dir][i][0];
+          if (b[lookup] == BLANK) slide_lookups[pos][dir][lookup] = true;
+        }
+        const int next = curr + State::DIRECTIONS[dir];
+        if (b[next] != BLANK) break;
+        curr = next;
+      }
+      slide_end[pos][dir] = curr;
+    }
+  }
 }
 
-std::string Board::DebugString() const {
+template <class G>
+std::string BasicBoard<G>::DebugString() const {
   return DebugString(NULL);
 }
 
-std::string Board::DebugStringWithState(const State &s) const {
+template <class G>
+std::string BasicBoard<G>::DebugStringWithState(const State &s) const {
   return DebugString(&s);
 }
 
-std::string Board::DebugStringWithDistance() const {
+template <class G>
+std::string BasicBoard<G>::DebugStringWithDistance() const {
   std::string s;
   int pos = 0;
   for (int y = 0; y < BOARD_Y; ++y) {
@@ -57,7 +145,8 @@ std::string Board::DebugStringWithDistance() const {
   return s;
 }
 
-std::string Board::DebugString(const State *state) const {
+template <class G>
+std::string BasicBoard<G>::DebugString(const State *state) const {
   std::string s;
   int pos = 0;
   for (int y = 0; y < BOARD_Y; ++y) {
@@ -83,7 +172,8 @@ std::string Board::DebugString(const State *state) const {
   return s;
 }
 
-std::string Board::DebugStringNice(const State &state) const {
+template <class G>
+std::string BasicBoard<G>::DebugStringNice(const State &state) const {
   std::stringstream res;
   int pos = 0;
   for (int y = 0; y < BOARD_Y; ++y) {
@@ -113,9 +203,10 @@ std::string Board::DebugStringNice(const State &state) const {
   return res.str();
 }
 
-std::string Board::DebugStringNiceWithMove(const State &state,
-                                           int tile_index,
-                                           int dir) const {
+template <class G>
+std::string BasicBoard<G>::DebugStringNiceWithMove(const State &state,
+                                                   int tile_index,
+                                                   int dir) const {
   char arrows[] = {'^', '<', '>', 'v'};
   int shift[] = {-BOARD_X * 6 - 2, -2, 2, BOARD_X * 6 + 2};
   string board_str = DebugStringNice(state);
@@ -127,7 +218,8 @@ std::string Board::DebugStringNiceWithMove(const State &state,
   return board_str;
 }
 
-void Board::ComputeDistances(int acg_pos) {
+template <class G>
+void BasicBoard<G>::ComputeDistances(int acg_pos) {
   for (int i = 0; i < BOARD_SIZE; ++i) {
     dist[i] = INFINITY;
   }
@@ -157,64 +249,334 @@ void Board::ComputeDistances(int acg_pos) {
   }
 }
 
-int Board::MinMovesFrom(const State &state) const {
+template <class G>
+int BasicBoard<G>::MinMovesFrom(const State &state) const {
   return dist[state.GetSquirrelPos()];
 }
 
+template <class G>
+void BasicBoard<G>::ComputeTransitions() {
+  const int squirrel = TriToCode("SQR") - 'a';
+  for (int t = 0; t < NUM_TYPES; ++t) {
+    become_mask[t] = 1 << t;
+    killers[t] = 0;
+  }
+  static_can_move = false;
+  for (int m = 0; m < NUM_TYPES; ++m) {
+    for (int st = 0; st < NUM_TYPES; ++st) {
+      for (int r = 0; r < Rules::NUM_RELATIONS; ++r) {
+        const Action a = rules.GetAction(m, st, r);
+        if (!a.exists) continue;
+        if (a.moving_new_animal < NUM_TYPES) {
+          become_mask[m] |= 1 << a.moving_new_animal;
+        }
+        if (a.static_new_animal != st) {
+          killers[st] |= 1 << m;
+          if (a.static_new_animal < NUM_TYPES) {
+            become_mask[st] |= 1 << a.static_new_animal;
+            if (!MOVEABLE[st] && MOVEABLE[a.static_new_animal]) {
+              static_can_move = true;
+            }
+          }
+        }
+      }
+    }
+  }
+  // Transitive closure.
+  for (int k = 0; k < NUM_TYPES; ++k) {
+    for (int t = 0; t < NUM_TYPES; ++t) {
+      if (become_mask[t] & (1 << k)) become_mask[t] |= become_mask[k];
+    }
+  }
+  for (int t = 0; t < NUM_TYPES; ++t) {
+    const Action ahead = rules.GetAction(squirrel, t, Rules::AHEAD);
+    const Action on = rules.GetAction(squirrel, t, Rules::ON);
+    blocks_squirrel[t] = (ahead.exists && !ahead.won) || (on.exists && on.lost);
+  }
+}
+
+template <class G>
+void BasicBoard<G>::ComputeRelevance(const char *p) {
+  // The tiles of the start layout.
+  int num_tiles = 0;
+  int tile_pos[MAX_TILES];
+  bool mobile[MAX_TILES];
+  has_squirrel = false;
+  for (int i = 0; i < BOARD_SIZE && num_tiles < MAX_TILES; ++i) {
+    const int type = p[i] - 'a';
+    if (p[i] < 'a' || type >= NUM_TYPES) continue;
+    tile_pos[num_tiles] = i;
+    mobile[num_tiles] = false;
+    for (int u = 0; u < NUM_TYPES; ++u) {
+      if ((become_mask[type] & (1 << u)) && MOVEABLE[u]) {
+        mobile[num_tiles] = true;
+      }
+    }
+    if (p[i] == TriToCode("SQR")) has_squirrel = true;
+    ++num_tiles;
+  }
+
+  // reach: cells a tile may stop on. A slide can only stop where it hits a
+  // wall or where another tile may be next to it (blocking it or firing a
+  // rule), so grow the reach of every tile together until nothing changes.
+  // area: reach plus every cell the tile may slide over.
+  std::vector<std::vector<bool> > reach(
+      num_tiles, std::vector<bool>(BOARD_SIZE, false));
+  std::vector<std::vector<bool> > area = reach;
+  std::vector<int> cover(BOARD_SIZE, 0);  // Number of tiles reaching a cell.
+  for (int i = 0; i < num_tiles; ++i) {
+    reach[i][tile_pos[i]] = area[i][tile_pos[i]] = true;
+    ++cover[tile_pos[i]];
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int i = 0; i < num_tiles; ++i) {
+      if (!mobile[i]) continue;
+      for (int from = 0; from < BOARD_SIZE; ++from) {
+        if (!reach[i][from]) continue;
+        for (int di = 0; di < 4; ++di) {
+          const int dir = State::DIRECTIONS[di];
+          for (int pos = from + dir; b[pos] == BLANK; pos += dir) {
+            area[i][pos] = true;
+            bool may_stop = b[pos + dir] != BLANK;
+            for (int n = 0; n < 5 && !may_stop; ++n) {
+              const int near = n < 4 ? pos + State::DIRECTIONS[n] : pos;
+              may_stop = cover[near] > (reach[i][near] ? 1 : 0);
+            }
+            if (may_stop && !reach[i][pos]) {
+              reach[i][pos] = true;
+              ++cover[pos];
+              changed = true;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Tiles are relevant if they may come next to the squirrel or to another
+  // relevant tile.
+  std::vector<bool> relevant(num_tiles, !has_squirrel);
+  std::vector<int> queue;
+  for (int i = 0; i < num_tiles; ++i) {
+    if (p[tile_pos[i]] == TriToCode("SQR")) {
+      relevant[i] = true;
+      queue.push_back(i);
+    }
+  }
+  while (!queue.empty()) {
+    const int i = queue.back();
+    queue.pop_back();
+    for (int j = 0; j < num_tiles; ++j) {
+      if (relevant[j]) continue;
+      bool near = false;
+      for (int pos = 0; pos < BOARD_SIZE && !near; ++pos) {
+        if (!area[i][pos]) continue;
+        for (int n = 0; n < 5 && !near; ++n) {
+          near = area[j][n < 4 ? pos + State::DIRECTIONS[n] : pos];
+        }
+      }
+      if (near) {
+        relevant[j] = true;
+        queue.push_back(j);
+      }
+    }
+  }
+
+  // Whether any tile may become a blocker for IsDead().
+  may_block_squirrel = false;
+  for (int i = 0; i < num_tiles; ++i) {
+    const int mask = become_mask[p[tile_pos[i]] - 'a'];
+    for (int t = 0; t < NUM_TYPES; ++t) {
+      if ((mask & (1 << t)) && !MOVEABLE[t] && blocks_squirrel[t] &&
+          t != GOLDEN_ACORN) {
+        may_block_squirrel = true;
+      }
+    }
+  }
+
+  // Irrelevant tiles never move nor change, they are left out of the search.
+  num_irrelevant = 0;
+  state_space_reduction = 1;
+  for (int i = 0; i < BOARD_SIZE; ++i) irrelevant[i] = false;
+  for (int i = 0; i < num_tiles; ++i) {
+    if (relevant[i]) continue;
+    irrelevant[tile_pos[i]] = true;
+    ++num_irrelevant;
+    if (mobile[i]) {
+      state_space_reduction *= count(reach[i].begin(), reach[i].end(), true);
+    }
+  }
+}
+
+template <class G>
+std::string BasicBoard<G>::DebugStringWithRelevance(const State &s) const {
+  std::string str = DebugString(&s);
+  for (int i = 0; i < s.num_tiles; ++i) {
+    const int pos = s.t[i].pos;
+    if (irrelevant[pos]) str[pos + pos / BOARD_X] = '.';
+  }
+  return str;
+}
+
+template <class G>
+bool BasicBoard<G>::IsDead(const State &state) const {
+  if (!has_squirrel) return false;
+  if (!may_block_squirrel) {
+    for (int i = 0; i < state.num_tiles; ++i) {
+      if (state.t[i].type == SQUIRREL) {
+        return dist[state.t[i].pos] >= INFINITY;
+      }
+    }
+    return true;
+  }
+  int squirrel_pos = -1;
+  int present = 0;  // Every type the tiles may still turn into.
+  for (int i = 0; i < state.num_tiles; ++i) {
+    const int type = state.t[i].type;
+    if (type >= NUM_TYPES) continue;
+    present |= become_mask[type];
+    if (type == SQUIRREL) squirrel_pos = state.t[i].pos;
+  }
+  if (squirrel_pos == -1) return true;
+  if (dist[squirrel_pos] >= INFINITY) return true;
+
+  // Immovable tiles that no remaining tile can change stay forever.
+  std::bitset<BOARD_SIZE> open = open_cells;
+  bool blocked = false;
+  for (int i = 0; i < state.num_tiles; ++i) {
+    const int type = state.t[i].type;
+    if (type >= NUM_TYPES || MOVEABLE[type] || !blocks_squirrel[type] ||
+        (killers[type] & present)) {
+      continue;
+    }
+    open[state.t[i].pos] = false;
+    if (type != GOLDEN_ACORN) blocked = true;
+  }
+  if (!blocked) return false;
+  // Flood fill the cells from where the squirrel may get to a golden acorn.
+  // Sibling states mostly share the blockers, keep the last region.
+  if (open != dead_cache_open) {
+    std::bitset<BOARD_SIZE> reach = goal_cells & open;
+    while (true) {
+      std::bitset<BOARD_SIZE> next = reach | (reach << 1) | (reach >> 1) |
+          (reach << BOARD_X) | (reach >> BOARD_X);
+      next &= open;
+      if (next == reach) break;
+      reach = next;
+    }
+    dead_cache_open = open;
+    dead_cache_region = reach;
+  }
+  return !dead_cache_region[squirrel_pos];
+}
+
+template <class G>
+int BasicBoard<G>::HashWords(const State &state) const {
+  int num_dynamic = 0;
+  for (int i = 0; i < state.num_tiles; ++i) {
+    const Tile &tile = state.t[i];
+    const int slot = static_slot[tile.pos];
+    if (slot == IRRELEVANT) continue;
+    if (slot == -1 || MOVEABLE[tile.type]) ++num_dynamic;
+  }
+  return PackedWords(num_static, num_dynamic);
+}
+
+template <class G>
+int BasicBoard<G>::KeyWords(const State &start) const {
+  // Tiles never appear, only disappear or change type. A static slot keeps its
+  // bits when emptied, so the key can only grow if a tile leaves its slot.
+  if (static_can_move) return PackedWords(num_static, start.num_tiles);
+  return HashWords(start);
+}
+
+template <class G>
+int BasicBoard<G>::PackedWords(int num_static, int num_dynamic) {
+  // Same packing as State::Hash(): fields never straddle two words.
+  int words = 0;
+  int used = 64;
+  for (int i = 0; i < num_static + num_dynamic; ++i) {
+    const int bits = i < num_static ? STATIC_BITS : G::TILE_BITS;
+    if (used + bits > 64) { ++words; used = 0; }
+    used += bits;
+  }
+  return words;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // State
 ////////////////////////////////////////////////////////////////////////////////
 
-const int State::UP;
-const int State::LEFT;
-const int State::RIGHT;
-const int State::DOWN;
+template <class G>
+const int BasicState<G>::UP;
+template <class G>
+const int BasicState<G>::LEFT;
+template <class G>
+const int BasicState<G>::RIGHT;
+template <class G>
+const int BasicState<G>::DOWN;
+template <class G>
+const int BasicState<G>::HASH_SIZE;
+template <class G>
+const int BasicState<G>::LOSE;
+template <class G>
+const int BasicState<G>::WIN;
 
-const char State::DIRNAME[] = "ULRD";
-const int State::DIRECTIONS[] = {-BOARD_X, -1, +1, +BOARD_X};  // 3-dir must work!
+template <class G>
+const char BasicState<G>::DIRNAME[] = "ULRD";
+template <class G>  // 3-dir must work!
+const int BasicState<G>::DIRECTIONS[] = {-G::BOARD_X, -1, +1, +G::BOARD_X};
 
 // ON must be first, after that starting from UP and then clockwise.
-const int State::DIR_LOOKUP[][4][2] = {
+template <class G>
+const int BasicState<G>::DIR_LOOKUP[][4][2] = {
   {  // up
     {0, Rules::ON},  // on
-    {DIRECTIONS[State::UP], Rules::AHEAD},  // ahead
-    {DIRECTIONS[State::RIGHT], Rules::SIDE}, // side
-    {DIRECTIONS[State::LEFT], Rules::SIDE}, // side
+    {-G::BOARD_X, Rules::AHEAD},  // ahead
+    {+1, Rules::SIDE}, // side
+    {-1, Rules::SIDE}, // side
   },
   {  // left
     {0, Rules::ON},  // on
-    {DIRECTIONS[State::UP], Rules::SIDE}, // side
-    {DIRECTIONS[State::DOWN], Rules::SIDE}, // side
-    {DIRECTIONS[State::LEFT], Rules::AHEAD},  // ahead
+    {-G::BOARD_X, Rules::SIDE}, // side
+    {+G::BOARD_X, Rules::SIDE}, // side
+    {-1, Rules::AHEAD},  // ahead
   },
   {  // right
     {0, Rules::ON},  // on
-    {DIRECTIONS[State::UP], Rules::SIDE}, // side
-    {DIRECTIONS[State::RIGHT], Rules::AHEAD},  // ahead
-    {DIRECTIONS[State::DOWN], Rules::SIDE}, // side
+    {-G::BOARD_X, Rules::SIDE}, // side
+    {+1, Rules::AHEAD},  // ahead
+    {+G::BOARD_X, Rules::SIDE}, // side
   },
   {  // down
     {0, Rules::ON},  // on
-    {DIRECTIONS[State::RIGHT], Rules::SIDE}, // side
-    {DIRECTIONS[State::DOWN], Rules::AHEAD},  // ahead
-    {DIRECTIONS[State::LEFT], Rules::SIDE}, // side
+    {+1, Rules::SIDE}, // side
+    {+G::BOARD_X, Rules::AHEAD},  // ahead
+    {-1, Rules::SIDE}, // side
   },
 };
 
 
-State::State() {
+template <class G>
+BasicState<G>::BasicState() {
   history_len = 0;
 }
 
-State::State(const Board &board, const State &old_state, int tile_index, int move) {
+template <class G>
+BasicState<G>::BasicState(const Board &board, const State &old_state,
+                          int tile_index, int move) {
   old_state.Move(board, tile_index, move, this);
 }
 
-State::State(const char *p) {
+template <class G>
+BasicState<G>::BasicState(const char *p) {
   Initialize(p);
 }
 
-void State::Initialize(const char *p) {
+template <class G>
+void BasicState<G>::Initialize(const char *p) {
   history_len = 0;
   num_tiles = 0;
   for (int i = 0; i < MAX_TILES; ++i) { t[i].pos = 0; t[i].type = 0; }
@@ -223,7 +585,7 @@ void State::Initialize(const char *p) {
     if (c >= 'a' && c <= 'a' + ('Z'-'A')) {
       const int type = c - 'a';
       if (type == TriToCode("---") - 'a') continue;
-      if (num_tiles + 1 >= MAX_TILES) {
+      if (num_tiles >= MAX_TILES) {
         printf("Tile too high: '%c'. Increase MAX_TILES.\n", c);
         exit(10);
       }
@@ -235,15 +597,187 @@ void State::Initialize(const char *p) {
   Sort();
 }
 
-int State::Find(int pos) const {
+// The tile with position pos and everything else 0, as a 32 bit word.
+static inline unsigned int TileWord(int pos) {
+  Tile tile;
+  tile.dummy_ = 0;
+  tile.pos = pos;
+  tile.type = 0;
+  unsigned int word;
+  memcpy(&word, &tile, sizeof(word));
+  return word;
+}
+
+static int FindScalar(const Tile* t, int num_tiles, int pos) {
   for (int i = 0; i < num_tiles; ++i) {
-    if (t[i].pos == pos) {
-      return i;
-    }
+    if (t[i].pos == pos) return i;
   }
   return -1;
 }
 
+static void FindManyScalar(const Tile* t, int num_tiles, const int* pos,
+                           int num, int* found) {
+  // Separate passes stop at the match.
+  for (int k = 0; k < num; ++k) found[k] = FindScalar(t, num_tiles, pos[k]);
+}
+
+#ifdef GTN_X86
+// The SIMD versions compare the masked words of 4 or 8 tiles at once, without
+// branches. They read the tiles in groups of 4, up to 3 past num_tiles, which
+// MAX_TILES % 4 == 0 keeps inside the array. The bits of those are dropped.
+
+// Index of the lowest bit set of bits below num_tiles, or -1.
+static inline int FirstTile(unsigned int bits, int num_tiles) {
+  bits &= (1u << num_tiles) - 1;
+  return bits ? __builtin_ctz(bits) : -1;
+}
+
+static inline unsigned int MatchSse2(const Tile* t, __m128i mask, __m128i key) {
+  const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)t), mask);
+  return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+}
+
+static int FindSse2(const Tile* t, int num_tiles, int pos) {
+  const __m128i mask = _mm_set1_epi32(TileWord(0xFF));
+  const __m128i key = _mm_set1_epi32(TileWord(pos));
+  unsigned int bits = 0;
+  for (int i = 0; i < num_tiles; i += 4) {
+    bits |= MatchSse2(t + i, mask, key) << i;
+  }
+  return FirstTile(bits, num_tiles);
+}
+
+static void FindManySse2(const Tile* t, int num_tiles, const int* pos, int num,
+                         int* found) {
+  const __m128i mask = _mm_set1_epi32(TileWord(0xFF));
+  __m128i keys[4];
+  unsigned int bits[4];
+  for (int k = 0; k < 4; ++k) {
+    // A masked word never has bits outside the position.
+    keys[k] = _mm_set1_epi32(k < num ? TileWord(pos[k]) : ~0u);
+    bits[k] = 0;
+  }
+  for (int i = 0; i < num_tiles; i += 4) {
+    const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(t + i)),
+                                    mask);
+    for (int k = 0; k < 4; ++k) {
+      bits[k] |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, keys[k])))
+                 << i;
+    }
+  }
+  for (int k = 0; k < num; ++k) found[k] = FirstTile(bits[k], num_tiles);
+}
+
+__attribute__((target("avx2")))
+static int FindAvx2(const Tile* t, int num_tiles, int pos) {
+  const __m256i mask = _mm256_set1_epi32(TileWord(0xFF));
+  const __m256i key = _mm256_set1_epi32(TileWord(pos));
+  unsigned int bits = 0;
+  int i = 0;
+  for (; i + 4 < num_tiles; i += 8) {
+    const __m256i v = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i*)(t + i)), mask);
+    bits |= _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key)))
+            << i;
+  }
+  if (i < num_tiles) {
+    bits |= MatchSse2(t + i, _mm256_castsi256_si128(mask),
+                      _mm256_castsi256_si128(key)) << i;
+  }
+  return FirstTile(bits, num_tiles);
+}
+
+__attribute__((target("avx2")))
+static void FindManyAvx2(const Tile* t, int num_tiles, const int* pos, int num,
+                         int* found) {
+  const __m256i mask = _mm256_set1_epi32(TileWord(0xFF));
+  __m256i keys[4];
+  unsigned int bits[4];
+  for (int k = 0; k < 4; ++k) {
+    keys[k] = _mm256_set1_epi32(k < num ? TileWord(pos[k]) : ~0u);
+    bits[k] = 0;
+  }
+  int i = 0;
+  for (; i + 4 < num_tiles; i += 8) {
+    const __m256i v = _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i*)(t + i)), mask);
+    for (int k = 0; k < 4; ++k) {
+      bits[k] |= _mm256_movemask_ps(
+                     _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, keys[k])))
+                 << i;
+    }
+  }
+  if (i < num_tiles) {
+    for (int k = 0; k < 4; ++k) {
+      bits[k] |= MatchSse2(t + i, _mm256_castsi256_si128(mask),
+                           _mm256_castsi256_si128(keys[k])) << i;
+    }
+  }
+  for (int k = 0; k < num; ++k) found[k] = FirstTile(bits[k], num_tiles);
+}
+#endif
+
+static const char* FIND_IMPL_NAMES[] = { "scalar", "sse2", "avx2" };
+
+const char* FindImplName(FindImpl impl) { return FIND_IMPL_NAMES[impl]; }
+
+bool FindImplSupported(FindImpl impl) {
+#ifdef GTN_X86
+  // Static initialization may get here before libgcc's.
+  __builtin_cpu_init();
+  // SSE2 is there whenever the compiler targets it.
+  if (impl == FIND_SSE2) return true;
+  if (impl == FIND_AVX2) return __builtin_cpu_supports("avx2");
+#endif
+  return impl == FIND_SCALAR;
+}
+
+static FindImpl DefaultFindImpl() {
+  const char* env = getenv("GTN_FIND");
+  for (int i = 0; env != NULL && i < NUM_FIND_IMPLS; ++i) {
+    if (strcmp(env, FIND_IMPL_NAMES[i]) == 0 &&
+        FindImplSupported(FindImpl(i))) {
+      return FindImpl(i);
+    }
+  }
+  // AVX2 is slower on the solver's tile counts, its kernels can't be inlined
+  // into Move() and at most 24 tiles only take 3 instead of 6 compares.
+  return FindImplSupported(FIND_SSE2) ? FIND_SSE2 : FIND_SCALAR;
+}
+
+static FindImpl find_impl = DefaultFindImpl();
+
+FindImpl GetFindImpl() { return find_impl; }
+
+bool SetFindImpl(FindImpl impl) {
+  if (!FindImplSupported(impl)) return false;
+  find_impl = impl;
+  return true;
+}
+
+template <class G>
+int BasicState<G>::Find(int pos) const {
+  static_assert(MAX_TILES % 4 == 0, "Find() reads the tiles in groups of 4.");
+  switch (find_impl) {
+#ifdef GTN_X86
+    case FIND_AVX2: return FindAvx2(t, num_tiles, pos);
+    case FIND_SSE2: return FindSse2(t, num_tiles, pos);
+#endif
+    default: return FindScalar(t, num_tiles, pos);
+  }
+}
+
+template <class G>
+void BasicState<G>::FindMany(const int* pos, int num, int* found) const {
+  switch (find_impl) {
+#ifdef GTN_X86
+    case FIND_AVX2: FindManyAvx2(t, num_tiles, pos, num, found); return;
+    case FIND_SSE2: FindManySse2(t, num_tiles, pos, num, found); return;
+#endif
+    default: FindManyScalar(t, num_tiles, pos, num, found);
+  }
+}
+
 struct ActionInfo {
   Action action;
   int static_tile_index;
@@ -258,8 +792,16 @@ inline int prio_cmp(const void* a, const void* b) {
 
 
 
-int State::Move(
-    const Board &board, int moving_tile_index, int dir, State *n) const {
+template <class G>
+int BasicState<G>::Move(const Board &board, int tile_index, int dir, State *n,
+                        int* slide_len) const {
+  return Move(board, tile_index, dir, n, slide_len, NULL);
+}
+
+template <class G>
+int BasicState<G>::Move(
+    const Board &board, int moving_tile_index, int dir, State *n,
+    int* slide_len, typename Board::SlideOutcome* outcome) const {
   LOG(1) << "\n\nMove start: " << char(t[moving_tile_index].type + 'a')
          << " " << DIRNAME[dir] << endl;
   const int move = DIRECTIONS[dir];
@@ -273,6 +815,14 @@ int State::Move(
     n->history[n->history_len++] = hist;
   }
   Tile* moving_tile = &(n->t[moving_tile_index]);
+  if (slide_len != NULL) *slide_len = 0;
+  if (outcome != NULL) {
+    outcome->result = 0;
+    outcome->end = moving_tile->pos;
+    outcome->slide_len = 0;
+    outcome->moving_type = moving_tile->type;
+    outcome->num_changes = 0;
+  }
   if (board.b[moving_tile->pos + DIRECTIONS[dir]] != BLANK) return 0;
   int curr_pos = moving_tile->pos;
   LOG(1) << board.DebugStringWithState(*n);
@@ -284,6 +834,14 @@ int State::Move(
   while (true) {
     // We just landed on curr_pos. We check all the possible rules.
     LOG(2) << "Landed on tile " << curr_pos << endl;
+    // Tiles around curr_pos by DIR_LOOKUP index, all but the one ON (index 0)
+    // which we already know.
+    int around_pos[4];
+    int around[4];
+    for (int i = 1; i < 4; ++i) {
+      around_pos[i] = curr_pos + DIR_LOOKUP[dir][i][0];
+    }
+    n->FindMany(around_pos + 1, 3, around + 1);
     for (int i = 0; i < 4; ++i) {
       const int lookup_dir = DIR_LOOKUP[dir][i][0];
       const int relation = DIR_LOOKUP[dir][i][1];
@@ -301,7 +859,7 @@ int State::Move(
         // overwrite tile_on_index.
         static_tile_index = tile_on_index;
       } else {
-        static_tile_index = n->Find(lookup_pos);
+        static_tile_index = around[i];
       }
       if (relation == Rules::AHEAD) {
         tile_on_index = static_tile_index;
@@ -330,6 +888,11 @@ int State::Move(
     LOG(2) << board.DebugStringWithState(*n);
     curr_pos = next_pos;
     has_moved = true;
+    if (slide_len != NULL) ++*slide_len;
+  }
+  if (outcome != NULL) {
+    outcome->end = curr_pos;
+    outcome->slide_len = (curr_pos - o->t[moving_tile_index].pos) / move;
   }
   // No actions on the start position.
   if (!has_moved) return 0;
@@ -345,8 +908,9 @@ int State::Move(
 
   // Special case when bear is surrounded by wolves
   if (num_woves_around_bear == 3) {
-    LOG(-5) << "BEAR SURROUNDED!" << endl;
+    LOG(2) << "bear surrounded" << endl;
     moving_tile->type = TriToCode("END") - 'a';
+    if (outcome != NULL) outcome->moving_type = moving_tile->type;
   } else {
     // Sort actions by prio
     LOG(2) << "Before sort\n";
@@ -363,14 +927,22 @@ int State::Move(
       const Action& a = action_infos[i].action;
       const int &static_tile_index = action_infos[i].static_tile_index;
       LOG(2) << board.DebugStringWithState(*n);
-      if (a.lost) return LOSE;
-      if (a.won) return WIN;
+      if (a.lost || a.won) {
+        if (outcome != NULL) outcome->result = a.lost ? LOSE : WIN;
+        return a.lost ? LOSE : WIN;
+      }
       LOG(1) << "ApplyAction: " << moving_tile_index << " " 
              << static_tile_index << endl;
       LOG(1) << PrintAction(a);
       int orig_moving_type = moving_tile->type;
       n->t[moving_tile_index].type = a.moving_new_animal;
       n->t[static_tile_index].type = a.static_new_animal;
+      if (outcome != NULL) {
+        outcome->moving_type = a.moving_new_animal;
+        outcome->change_pos[outcome->num_changes] = n->t[static_tile_index].pos;
+        outcome->change_type[outcome->num_changes] = a.static_new_animal;
+        ++outcome->num_changes;
+      }
       LOG(2) << board.DebugStringWithState(*n);
       if (a.moving_new_animal != orig_moving_type) {
         // Stop applying the rest of the action_infos.
@@ -385,25 +957,161 @@ int State::Move(
   return 0;
 }
 
-void State::Hash(HashValue hash) const {
-  for (int i = 0; i < HASH_SIZE; ++i) hash[i] = 0;
-  int idx_tile = 0;
-  int idx_hash = 0;
-  while (idx_tile < num_tiles) {
-    for (int i = 0; i < 6; ++i) {
-      int local_hash = (t[idx_tile].type << 6) + t[idx_tile].pos - BOARD_X;
-      hash[idx_hash] <<= 10;
-      hash[idx_hash] += local_hash;
-      if (++idx_tile >= num_tiles) break;
+template <class G>
+void BasicState<G>::GetOccupied(Cells *occupied) const {
+  occupied->reset();
+  for (int i = 0; i < num_tiles; ++i) (*occupied)[t[i].pos] = true;
+}
+
+template <class G>
+int BasicState<G>::Move(const Board &board, int tile_index, int dir,
+                        const Cells &occupied, State *n,
+                        int* slide_len) const {
+  const int pos = t[tile_index].pos;
+  if (!(board.slide_lookups[pos][dir] & occupied).any()) {
+    // No rule can fire, the tile slides to the wall.
+    *n = *this;
+    HistoryItem hist;
+    hist.tile_index = tile_index;
+    hist.dir = dir;
+    n->history[n->history_len++] = hist;
+    const int end = board.slide_end[pos][dir];
+    if (slide_len != NULL) *slide_len = (end - pos) / DIRECTIONS[dir];
+    if (end == pos) return 0;
+    n->t[tile_index].pos = end;
+    n->Sort();
+    return 0;
+  }
+  unsigned long long key[3];
+  if (!SlideKey(board, tile_index, dir, key)) {
+    return Move(board, tile_index, dir, n, slide_len);
+  }
+  if (board.slide_cache.empty()) {
+    board.slide_cache.resize(Board::SLIDE_CACHE_SIZE);
+  }
+  ++board.slide_cache_lookups;
+  const unsigned long long h = (key[0] ^ (key[1] * 0x9E3779B97F4A7C15ULL) ^
+                                (key[2] * 0xC2B2AE3D27D4EB4FULL)) *
+                               0xFF51AFD7ED558CCDULL;
+  typename Board::SlideOutcome& entry =
+      board.slide_cache[(h >> 32) & (Board::SLIDE_CACHE_SIZE - 1)];
+  if (entry.key[0] != key[0] || entry.key[1] != key[1] ||
+      entry.key[2] != key[2]) {
+    const int res = Move(board, tile_index, dir, n, slide_len, &entry);
+    for (int i = 0; i < 3; ++i) entry.key[i] = key[i];
+    return res;
+  }
+  ++board.slide_cache_hits;
+  *n = *this;
+  HistoryItem hist;
+  hist.tile_index = tile_index;
+  hist.dir = dir;
+  n->history[n->history_len++] = hist;
+  if (slide_len != NULL) *slide_len = entry.slide_len;
+  // The static tiles are found before the moving one gets to their cells.
+  int changed[4];
+  for (int i = 0; i < entry.num_changes; ++i) {
+    changed[i] = Find(entry.change_pos[i]);
+  }
+  n->t[tile_index].pos = entry.end;
+  n->t[tile_index].type = entry.moving_type;
+  for (int i = 0; i < entry.num_changes; ++i) {
+    n->t[changed[i]].type = entry.change_type[i];
+  }
+  if (entry.result != 0) return entry.result;
+  n->Sort();
+  while (n->t[n->num_tiles-1].type == TriToCode("---") - 'a') --n->num_tiles;
+  return 0;
+}
+
+template <class G>
+bool BasicState<G>::SlideKey(const Board &board, int tile_index, int dir,
+                             unsigned long long key[3]) const {
+  // 16 bits for the moving tile and 16 for each tile next to the slide, in
+  // tile order, which is the order Find() sees them in.
+  const std::bitset<BOARD_SIZE>& lookups =
+      board.slide_lookups[t[tile_index].pos][dir];
+  key[0] = (t[tile_index].type << 10) + (t[tile_index].pos << 2) + dir;
+  key[1] = key[2] = 0;
+  int num = 1;
+  for (int i = 0; i < num_tiles; ++i) {
+    if (i == tile_index || !lookups[t[i].pos]) continue;
+    if (num == 12) return false;
+    key[num / 4] |= (unsigned long long)((t[i].type << 8) + t[i].pos)
+                    << (num % 4 * 16);
+    ++num;
+  }
+  return true;
+}
+
+template <class G>
+void BasicState<G>::Hash(const Board &board, HashValue hash,
+                         int words) const {
+  for (int i = 0; i < words; ++i) hash[i] = 0;
+  // Current type of the immovable tile on each static slot.
+  unsigned char slots[MAX_TILES];
+  for (int i = 0; i < board.num_static; ++i) slots[i] = STATIC_EMPTY;
+  bool dynamic[MAX_TILES];
+  for (int i = 0; i < num_tiles; ++i) {
+    const int slot = board.static_slot[t[i].pos];
+    // Irrelevant tiles are the same in every state.
+    dynamic[i] = slot == -1 || (slot >= 0 && MOVEABLE[t[i].type]);
+    if (slot >= 0 && !dynamic[i]) slots[slot] = t[i].type;
+  }
+  // Fields are packed from the most significant bit and never straddle two
+  // words. Slots come first and have a fixed count, and a dynamic tile is never
+  // all zero (pos - BOARD_X > 0 as column 0 is a wall), so trailing zeros are
+  // always padding.
+  int idx_hash = -1;
+  int used = 64;
+  for (int i = 0; i < board.num_static + num_tiles; ++i) {
+    int bits, value;
+    if (i < board.num_static) {
+      bits = STATIC_BITS;
+      value = slots[i];
+    } else {
+      const int idx_tile = i - board.num_static;
+      if (!dynamic[idx_tile]) continue;
+      bits = G::TILE_BITS;
+      value = (t[idx_tile].type << G::POS_BITS) + t[idx_tile].pos - BOARD_X;
     }
-    ++idx_hash;
+    if (used + bits > 64) {
+      if (idx_hash >= 0) hash[idx_hash] <<= 64 - used;
+      ++idx_hash;
+      assert(idx_hash < words && "Fewer words than Board::HashWords().");
+      used = 0;
+    }
+    hash[idx_hash] = (hash[idx_hash] << bits) + value;
+    used += bits;
   }
+  if (idx_hash >= 0) hash[idx_hash] <<= 64 - used;
 }
 
-const State::HistoryItem *State::GetHistory() const {
+template <class G>
+const typename BasicState<G>::HistoryItem *BasicState<G>::GetHistory() const {
   return history;
 }
 
-int State::GetHistoryLen() const {
+template <class G>
+int BasicState<G>::GetHistoryLen() const {
   return history_len;
 }
+
+template <class G>
+void BasicState<G>::Set(const Tile *tiles, int num_tiles_,
+                        const HistoryItem *history_, int history_len_) {
+  num_tiles = num_tiles_;
+  for (int i = 0; i < MAX_TILES; ++i) {
+    t[i].dummy_ = 0;
+    t[i].pos = i < num_tiles ? tiles[i].pos : 0;
+    t[i].type = i < num_tiles ? tiles[i].type : 0;
+  }
+  history_len = history_len_;
+  for (int i = 0; i < history_len; ++i) history[i] = history_[i];
+}
+
+#define INSTANTIATE(G)                 \
+  template class BasicBoard<G>;        \
+  template class BasicState<G>;
+GTN_FOR_EACH_GEOMETRY(INSTANTIATE)
+#undef INSTANTIATE
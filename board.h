@@ -1,16 +1,69 @@
 #ifndef _GTN_BOARD_H__
 #define _GTN_BOARD_H__
 
+#include <stdlib.h>
+#include <bitset>
 #include <string>
- 
-static const int BOARD_X = 10;
-static const int BOARD_Y = 8;
+#include <vector>
 
-static const int BOARD_SIZE = BOARD_X * BOARD_Y;
+static const int MAX_HISTORY = 40;
 
-static const int MAX_TILES = 12;
+// Bits of a tile type in State::Hash().
+static const int TYPE_BITS = 4;
 
-static const int MAX_HISTORY = 40;
+// Number of tile types, 'a' to 'o'. The next code is "---".
+static const int NUM_TYPES = 15;
+
+// Number of bits needed to store the values 0..n-1.
+constexpr int BitsFor(int n) {
+  return n <= 1 ? 0 : 1 + BitsFor((n + 1) / 2);
+}
+
+// Compile time board dimensions. X and Y include the surrounding walls, TILES
+// is the capacity of a State.
+template <int X, int Y, int TILES>
+struct Geometry {
+  static const int BOARD_X = X;
+  static const int BOARD_Y = Y;
+  static const int BOARD_SIZE = X * Y;
+  static const int MAX_TILES = TILES;
+  // Position bits in State::Hash(). The first and last rows are all wall.
+  static const int POS_BITS = BitsFor((Y - 2) * X);
+  static const int TILE_BITS = TYPE_BITS + POS_BITS;
+  // Words for MAX_TILES tiles. A field never straddles two words.
+  static const int HASH_SIZE =
+      (MAX_TILES + 64 / TILE_BITS - 1) / (64 / TILE_BITS);
+};
+
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::BOARD_X;
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::BOARD_Y;
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::BOARD_SIZE;
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::MAX_TILES;
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::POS_BITS;
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::TILE_BITS;
+template <int X, int Y, int TILES> const int Geometry<X, Y, TILES>::HASH_SIZE;
+
+// The board of the original game, 6x8 cells surrounded by walls.
+typedef Geometry<10, 8, 20> StandardGeometry;
+// Custom boards up to 8x10 and 10x14 cells. Their tiles take 11 and 12 bits,
+// 5 to a word, so 20 of them fill the widest key.
+typedef Geometry<12, 10, 20> LargeGeometry;
+typedef Geometry<16, 12, 20> HugeGeometry;
+
+// Every geometry the solver is compiled for, ordered by size. The templates
+// are explicitly instantiated for these in board.cc and solve.cc.
+#define GTN_FOR_EACH_GEOMETRY(F) \
+  F(StandardGeometry)            \
+  F(LargeGeometry)               \
+  F(HugeGeometry)
+
+// Dimensions of the standard board.
+static const int BOARD_X = StandardGeometry::BOARD_X;
+static const int BOARD_Y = StandardGeometry::BOARD_Y;
+
+static const int BOARD_SIZE = StandardGeometry::BOARD_SIZE;
+
+static const int MAX_TILES = StandardGeometry::MAX_TILES;
 
 static inline int POS(int Y, int X) {
   return Y * BOARD_X + X;
@@ -25,18 +78,67 @@ static inline int MY_intcmp(const void *aa, const void *bb) {
 }
 
 
+// Whether a tile type can be moved by the player. Immovable tiles never change
+// position, they can only disappear or change type in place.
+extern const int MOVEABLE[];
+
+// Packed State::Hash() of WORDS 64 bit words. The solver picks the narrowest
+// key a level fits into, see Board::KeyWords().
+template <int WORDS>
+struct StateKey {
+  unsigned long long w[WORDS];
+
+  bool operator<(const StateKey& o) const {
+    for (int i = 0; i < WORDS; ++i) {
+      if (w[i] != o.w[i]) return w[i] < o.w[i];
+    }
+    return false;
+  }
+  bool operator==(const StateKey& o) const {
+    for (int i = 0; i < WORDS; ++i) {
+      if (w[i] != o.w[i]) return false;
+    }
+    return true;
+  }
+};
+
+// Widest key solve() supports, 256 bits.
+static const int MAX_KEY_WORDS = 4;
+
 struct Tile {
   unsigned int dummy_: 16;
   unsigned int pos : 8;
   unsigned int type : 8;
 };
 
+// Implementations of State::Find(). FIND_SCALAR is 0 so that Find() works
+// before static initialization picks one.
+enum FindImpl { FIND_SCALAR, FIND_SSE2, FIND_AVX2, NUM_FIND_IMPLS };
+
+const char* FindImplName(FindImpl impl);
+bool FindImplSupported(FindImpl impl);
+// The implementation Find() uses. Defaults to $GTN_FIND if set to a supported
+// name, otherwise to SSE2 where the compiler targets it.
+FindImpl GetFindImpl();
+// Returns false and keeps the current one if the CPU doesn't support impl.
+bool SetFindImpl(FindImpl impl);
+
 class Action;
-class Board;
 class Rules;
+template <class G> class BasicBoard;
+template <class G> class BasicStateRanker;
 
-class State {
+template <class G>
+class BasicState {
  public:
+  typedef BasicBoard<G> Board;
+  typedef BasicState<G> State;
+
+  static const int BOARD_X = G::BOARD_X;
+  static const int BOARD_Y = G::BOARD_Y;
+  static const int BOARD_SIZE = G::BOARD_SIZE;
+  static const int MAX_TILES = G::MAX_TILES;
+
   static const int UP = 0;
   static const int LEFT = 1;
   static const int RIGHT = 2;
@@ -53,7 +155,9 @@ class State {
     unsigned char dir : 2;
   };
 
-  static const int HASH_SIZE = 2;
+  static const int HASH_SIZE = G::HASH_SIZE;
+  static_assert(HASH_SIZE <= MAX_KEY_WORDS,
+                "A full state needs a key wider than solve() supports.");
   typedef unsigned long long *HashValue;
   struct CmpByHash {
     bool operator()(const HashValue& a, const HashValue& b) const {
@@ -66,18 +170,39 @@ class State {
     }
   };
 
-  State();
+  BasicState();
 
-  explicit State(const char *p);
+  explicit BasicState(const char *p);
   // Make a move on a board.
   // dir is the direction (0, 1, 2, 3) or (UP, LEFT, RIGHT, DOWN)
   // n is the new state.
   // Return value: 0 if we are alive, 1 if dead, 2 if won.
-  int Move(const Board &board, int tile_index, int dir, State *n) const;
+  // slide_len: if not NULL, gets the number of cells the tile slid.
+  int Move(const Board &board, int tile_index, int dir, State *n,
+           int* slide_len = NULL) const;
   // Move based constructor.
-  State(const Board &board, const State &old_state, int tile_index, int move);
+  BasicState(const Board &board, const State &old_state, int tile_index,
+             int move);
+
+  // Cells with a tile on them.
+  typedef std::bitset<BOARD_SIZE> Cells;
+  void GetOccupied(Cells *occupied) const;
+  // Move() given the occupied cells of this state, from GetOccupied(). A slide
+  // that passes no other tile skips the rule lookups, others are looked up in
+  // the board's slide cache by the tiles next to the slide.
+  int Move(const Board &board, int tile_index, int dir, const Cells &occupied,
+           State *n, int* slide_len = NULL) const;
+
+  // Packs the state into words (at most HASH_SIZE). Immovable tiles sitting on
+  // one of the board's static slots only take 4 bits for their current type,
+  // all other tiles take G::TILE_BITS bits. words must be at least
+  // Board::HashWords(), fewer is an assertion failure.
+  void Hash(const Board &board, HashValue, int words = HASH_SIZE) const;
 
-  void Hash(HashValue) const;
+  template <int WORDS>
+  void Hash(const Board &board, StateKey<WORDS> *key) const {
+    Hash(board, key->w, WORDS);
+  }
 
   int NumTiles() const { return num_tiles; }
   const Tile& GetTile(int index) const { return t[index]; }
@@ -86,21 +211,39 @@ class State {
 
   const HistoryItem *GetHistory() const;
   int GetHistoryLen() const;
+  // Sets the tiles and the moves that led here, as NumTiles(), GetTile(),
+  // GetHistory() and GetHistoryLen() of the state to copy give them. At most
+  // MAX_TILES tiles and MAX_HISTORY moves.
+  void Set(const Tile *tiles, int num_tiles, const HistoryItem *history,
+           int history_len);
+  // Forgets the moves that led here, e.g. before using the state as a new
+  // start. Move() appends to the history, which holds MAX_HISTORY moves.
+  void ClearHistory() { history_len = 0; }
 
  protected:
   void Initialize(const char *p);
+  // Key of the slide cache for moving tile_index in dir, false if too many
+  // tiles are next to the slide.
+  bool SlideKey(const Board &board, int tile_index, int dir,
+                unsigned long long key[3]) const;
+  // Move() that also describes what it did in outcome, if not NULL.
+  int Move(const Board &board, int tile_index, int dir, State *n,
+           int* slide_len, typename Board::SlideOutcome* outcome) const;
   // --------------------------------------------------
   // Visible for testing
 
   // Find the tile occupying a position. Return index or -1.
   int Find(int pos) const;
+  // Find() of num <= 4 positions in one pass over the tiles.
+  void FindMany(const int* pos, int num, int* found) const;
 
   inline void Sort() {
     qsort((void *)t, num_tiles, sizeof(int), MY_intcmp);
   }
 
  private:
-  friend class Board;
+  friend class BasicBoard<G>;
+  friend class BasicStateRanker<G>;
   int num_tiles;
   Tile t[MAX_TILES];      // Tiles.
   unsigned char history_len;
@@ -110,9 +253,17 @@ class State {
 typedef int Cell;
 static const Cell BLANK = ' ';
 
-class Board {
+template <class G>
+class BasicBoard {
  public:
-  explicit Board(const char *i, const Rules& rules);
+  typedef BasicState<G> State;
+
+  static const int BOARD_X = G::BOARD_X;
+  static const int BOARD_Y = G::BOARD_Y;
+  static const int BOARD_SIZE = G::BOARD_SIZE;
+  static const int MAX_TILES = G::MAX_TILES;
+
+  explicit BasicBoard(const char *i, const Rules& rules);
   std::string DebugString() const;
   std::string DebugStringWithState(const State &s) const;
   std::string DebugStringNice(const State &state) const;
@@ -124,17 +275,120 @@ class Board {
   // The minimum number of moves required from state.
   int MinMovesFrom(const State &state) const;
 
+  // Whether the squirrel can never reach the golden acorn from state: it is
+  // gone, walled off, or boxed in by tiles that nothing left on the board can
+  // move or remove.
+  bool IsDead(const State &state) const;
+
+  // Number of 64 bit words State::Hash() needs for state.
+  int HashWords(const State &state) const;
+
+  // Number of 64 bit words that hold every state reachable from start.
+  int KeyWords(const State &start) const;
+
+  // Tiles that can never get near the squirrel, directly or through other
+  // tiles, are irrelevant. They are not moved and not hashed by the solver.
+  bool IsRelevant(int pos) const { return !irrelevant[pos]; }
+  int NumIrrelevant() const { return num_irrelevant; }
+  // Product of the number of cells each irrelevant tile could stop on.
+  double StateSpaceReduction() const { return state_space_reduction; }
+  // Irrelevant tiles are shown as '.'.
+  std::string DebugStringWithRelevance(const State &s) const;
+
+  // Whether pos is not a wall.
+  bool IsOpen(int pos) const { return open_cells[pos]; }
+  // Bit u: a tile of type may turn into type u, see ComputeTransitions().
+  int BecomeMask(int type) const { return become_mask[type]; }
+
+  int NumStatic() const { return num_static; }
+  // The static slot at pos, negative if none.
+  int StaticSlot(int pos) const { return static_slot[pos]; }
+
+  // Lookups and hits of the slide cache since the board was made.
+  long long SlideCacheLookups() const { return slide_cache_lookups; }
+  long long SlideCacheHits() const { return slide_cache_hits; }
+
  private:
-  friend class State;
+  friend class BasicState<G>;
+
+  // What a Move() did: where the tile stopped, its type, the types the static
+  // tiles changed to, by position, in the order they changed, and the return
+  // value. The changes are applied before the return, also on WIN or LOSE.
+  struct SlideOutcome {
+    // The moving tile and the tiles next to its slide, see SlideKey(). 0 for
+    // an empty entry.
+    unsigned long long key[3];
+    signed char result;
+    unsigned char end;
+    unsigned char slide_len;
+    unsigned char moving_type;
+    unsigned char num_changes;
+    unsigned char change_pos[4];
+    unsigned char change_type[4];
+  };
   Cell b[BOARD_Y * BOARD_X];  // Board.
   const Rules& rules;
 
   int dist[BOARD_X * BOARD_Y];
 
+  // Static layout: the positions of the immovable tiles of the start state.
+  int num_static;
+  int static_pos[MAX_TILES];
+  signed char static_slot[BOARD_SIZE];
+  // Whether a rule can turn an immovable tile into a moving one, taking it off
+  // its static slot.
+  bool static_can_move;
+
+  // Words needed for num_static slots and num_dynamic other tiles.
+  static int PackedWords(int num_static, int num_dynamic);
+
+  bool irrelevant[BOARD_SIZE];
+  int num_irrelevant;
+  double state_space_reduction;
+
   // Compute minimum number of moves to reash golden acorn.
   void ComputeDistances(int acg_pos);
 
+  // Reachability and interaction analysis of the start layout p.
+  void ComputeRelevance(const char *p);
+
+  // Type transitions of the rules.
+  // Bit u of become_mask[t]: a tile of type t may turn into type u.
+  int become_mask[NUM_TYPES];
+  // Bit m of killers[t]: a moving m may change or remove a static t.
+  int killers[NUM_TYPES];
+  // The squirrel can't get past a tile of this type.
+  bool blocks_squirrel[NUM_TYPES];
+  bool has_squirrel;
+  // Some tile is or may turn into an immovable tile blocking the squirrel.
+  bool may_block_squirrel;
+  void ComputeTransitions();
+
+  // Cells that are not walls, and the cells next to a golden acorn.
+  std::bitset<BOARD_SIZE> open_cells;
+  std::bitset<BOARD_SIZE> goal_cells;
+  // Cells Move() looks up sliding from an open pos in dir, and where the
+  // slide ends if none of them has a tile.
+  std::bitset<BOARD_SIZE> slide_lookups[BOARD_SIZE][4];
+  unsigned char slide_end[BOARD_SIZE][4];
+  void ComputeSlides();
+
+  // Direct mapped, allocated on the first lookup. Like the IsDead() cache it
+  // is changed by const methods.
+  static const int SLIDE_CACHE_SIZE = 1 << 12;
+  mutable std::vector<SlideOutcome> slide_cache;
+  mutable long long slide_cache_lookups;
+  mutable long long slide_cache_hits;
+
+  // Last open cells of IsDead() and the cells it found connected to a goal
+  // cell. A board must not be shared between threads.
+  mutable std::bitset<BOARD_SIZE> dead_cache_open;
+  mutable std::bitset<BOARD_SIZE> dead_cache_region;
+
   std::string DebugString(const State *state) const;
 };
 
+typedef BasicState<StandardGeometry> State;
+typedef BasicBoard<StandardGeometry> Board;
+
 #endif
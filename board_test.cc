@@ -412,6 +412,145 @@ TEST(TestBoard, DebugStringWithDistance) {
     "##########\n", b.DebugStringWithDistance());
 }
 
+TEST(TestBoard, Relevance) {
+  const char B[] =
+    "##########"
+    "#a      e#"
+    "#        #"
+    "#   b    #"
+    "#####    #"
+    "#d e#    #"
+    "#  d#  c #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  EXPECT_EQ(3, b.NumIrrelevant());
+  EXPECT_TRUE(b.IsRelevant(POS(1, 8)));
+  EXPECT_TRUE(b.IsRelevant(POS(6, 7)));
+  EXPECT_FALSE(b.IsRelevant(POS(5, 1)));
+  EXPECT_FALSE(b.IsRelevant(POS(5, 3)));
+  // The analysis lets each mouse stop on any of the 6 cells of its room.
+  EXPECT_EQ(36, b.StateSpaceReduction());
+  EXPECT_EQ(
+    "##########\n"
+    "#a      e#\n"
+    "#        #\n"
+    "#   b    #\n"
+    "#####    #\n"
+    "#. .#    #\n"
+    "#  .#  c #\n"
+    "##########\n", b.DebugStringWithRelevance(s));
+  // Only the acorns, the squirrel and the hog are hashed.
+  EXPECT_EQ(1, b.HashWords(s));
+  // Moving the mice doesn't change the key.
+  unsigned long long h1[State::HASH_SIZE];
+  unsigned long long h2[State::HASH_SIZE];
+  s.Hash(b, h1);
+  State n(b, s, 3, State::UP);
+  n.Hash(b, h2);
+  EXPECT_FALSE(State::CmpByHash()(h1, h2) || State::CmpByHash()(h2, h1));
+}
+
+TEST(TestBoard, DeadWalledOff) {
+  const char B[] =
+    "##########"
+    "#a   #   #"
+    "#    # b #"
+    "######   #"
+    "#        #"
+    "#        #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  EXPECT_TRUE(b.IsDead(State(B)));
+}
+
+TEST(TestBoard, DeadBoxedInByTrap) {
+  const char B[] =
+    "##########"
+    "#a       #"
+    "#        #"
+    "####h#####"
+    "#   b    #"
+    "#        #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  EXPECT_TRUE(b.IsDead(s));
+  // Moving around doesn't help.
+  State n(b, s, 1, State::DOWN);
+  EXPECT_TRUE(b.IsDead(n));
+  // A hog could fill the trap.
+  const char C[] =
+    "##########"
+    "#a       #"
+    "#        #"
+    "####h#####"
+    "#   b    #"
+    "#        #"
+    "#      c #"
+    "##########";
+  Board c(C, REAL_RULES);
+  EXPECT_FALSE(c.IsDead(State(C)));
+}
+
+TEST(TestBoard, DeadBoxedInBySwamp) {
+  const char B[] =
+    "##########"
+    "#a       #"
+    "####j#####"
+    "#        #"
+    "#   b    #"
+    "#        #"
+    "#        #"
+    "##########";
+  const char C[] =
+    "##########"
+    "#a       #"
+    "####j#####"
+    "#        #"
+    "#   b    #"
+    "#        #"
+    "#     d  #"
+    "##########";
+  Board b(B, REAL_RULES);
+  EXPECT_TRUE(b.IsDead(State(B)));
+  // A mouse could fill the swamp.
+  Board c(C, REAL_RULES);
+  EXPECT_FALSE(c.IsDead(State(C)));
+}
+
+TEST(TestBoard, NotDead) {
+  const char B[] =
+    "##########"
+    "#a  h    #"
+    "#   j    #"
+    "#   e    #"
+    "#   b    #"
+    "#        #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  EXPECT_FALSE(b.IsDead(State(B)));
+  // Without a squirrel.
+  const char C[] =
+    "##########"
+    "#a  h    #"
+    "#   j    #"
+    "#   e    #"
+    "#        #"
+    "#        #"
+    "#        #"
+    "##########";
+  EXPECT_TRUE(b.IsDead(State(C)));
+}
+
+TEST(TestBoard, AllRelevantWithoutSquirrel) {
+  Board b(B003, *RULES);
+  EXPECT_EQ(0, b.NumIrrelevant());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // State
 ////////////////////////////////////////////////////////////////////////////////
@@ -419,15 +558,21 @@ TEST(TestBoard, DebugStringWithDistance) {
 class TestableState : public State {
  public:
   explicit TestableState(const char *i) : State(i) {}
+  explicit TestableState(const State& s) : State(s) {}
   using State::Find;
+  using State::FindMany;
   using State::Sort;
 };
 
 TEST(TestState, TestStatic) {
   EXPECT_EQ(8, sizeof(long long));    // For hash.
-  EXPECT_LE(6 * State::HASH_SIZE, MAX_TILES) << "Hash won't fit.";
+  EXPECT_LE(MAX_TILES, 6 * State::HASH_SIZE) << "Hash won't fit.";
   EXPECT_LE(BOARD_SIZE - BOARD_X - BOARD_X, 64)
       << "Position won't fit on 6 bits in Hash().";
+  EXPECT_EQ(6, StandardGeometry::POS_BITS);
+  EXPECT_EQ(7, LargeGeometry::POS_BITS);
+  EXPECT_EQ(8, HugeGeometry::POS_BITS);
+  EXPECT_LE(HugeGeometry::BOARD_SIZE, 256) << "Position won't fit in Tile.";
   EXPECT_LE(16, TriToCode("END"))
       << "Type won't fit on 4 bits in hash.";
   EXPECT_EQ(BOARD_SIZE, BOARD_X * BOARD_Y);
@@ -460,15 +605,185 @@ TEST(TestState, Hash) {
   int N = State::HASH_SIZE;
   unsigned long long h1[N];
   unsigned long long h2[N];
+  Board b(B004, *RULES);
   TestableState s(B004);
-  s.Hash(h1);
-  s.Hash(h2);
+  s.Hash(b, h1);
+  s.Hash(b, h2);
   EXPECT_FALSE(State::CmpByHash()(h1, h2) || State::CmpByHash()(h2, h1));
   s.Sort();
-  s.Hash(h2);
+  s.Hash(b, h2);
   EXPECT_FALSE(State::CmpByHash()(h1, h2) || State::CmpByHash()(h2, h1));
 }
 
+TEST(TestState, HashStaticSlots) {
+  const char B[] =
+    "##########"
+    "#a  e   h#"
+    "#        #"
+    "#        #"
+    "#  b  e  #"
+    "#        #"
+    "#j     c #"
+    "##########";
+  Board b(B, REAL_RULES);
+  EXPECT_EQ(5, b.NumStatic());
+  EXPECT_EQ(0, b.StaticSlot(POS(1, 1)));
+  EXPECT_EQ(-1, b.StaticSlot(POS(4, 3)));
+  State s(B);
+  // 5 slots and 2 moving tiles fit in a single word.
+  EXPECT_EQ(1, b.HashWords(s));
+
+  int N = State::HASH_SIZE;
+  unsigned long long h1[N];
+  unsigned long long h2[N];
+  s.Hash(b, h1);
+  // Squirrel eats the acorn on its right and stops next to it.
+  State n(b, s, 1, State::RIGHT);
+  EXPECT_EQ(6, n.NumTiles()) << b.DebugStringWithState(n);
+  n.Hash(b, h2);
+  EXPECT_TRUE(State::CmpByHash()(h1, h2) || State::CmpByHash()(h2, h1));
+  // Moving back differs only in the acorn.
+  State back(b, n, 1, State::LEFT);
+  EXPECT_EQ(POS(4, 1), back.GetSquirrelPos());
+  unsigned long long h3[N];
+  back.Hash(b, h3);
+  EXPECT_TRUE(State::CmpByHash()(h1, h3) || State::CmpByHash()(h3, h1));
+  EXPECT_TRUE(State::CmpByHash()(h2, h3) || State::CmpByHash()(h3, h2));
+}
+
+TEST(TestState, LargeGeometry) {
+  typedef BasicBoard<LargeGeometry> LargeBoard;
+  typedef BasicState<LargeGeometry> LargeState;
+  const char B[] =
+    "############"
+    "#a         #"
+    "#          #"
+    "#          #"
+    "#          #"
+    "#          #"
+    "#          #"
+    "#          #"
+    "#         b#"
+    "############";
+  LargeBoard b(B, REAL_RULES);
+  LargeState s(B);
+  EXPECT_EQ(2, b.MinMovesFrom(s));
+  LargeState n(b, s, 1, LargeState::UP);
+  EXPECT_EQ(1 * 12 + 10, n.GetSquirrelPos());
+  EXPECT_EQ(1, b.MinMovesFrom(n));
+  EXPECT_EQ(LargeState::WIN, n.Move(b, 1, LargeState::LEFT, &s));
+}
+
+TEST(TestState, HashManyTiles) {
+  const char B[] =
+    "##########"
+    "#a e e e #"
+    "#        #"
+    "#hjhjhjh #"
+    "#  b     #"
+    "#c   f   #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  EXPECT_EQ(14, s.NumTiles());
+  EXPECT_LE(b.HashWords(s), State::HASH_SIZE);
+}
+
+TEST(TestState, FindImpls) {
+  const char B[] =
+    "##########"
+    "#a e e e #"
+    "#        #"
+    "#hjhjhjh #"
+    "#  b     #"
+    "#c   f   #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  const FindImpl orig = GetFindImpl();
+  srand(1);
+  for (int step = 0; step < 200; ++step) {
+    const TestableState ts(s);
+    for (int pos = 0; pos < BOARD_SIZE; ++pos) {
+      ASSERT_TRUE(SetFindImpl(FIND_SCALAR));
+      const int exp = ts.Find(pos);
+      if (exp >= 0) {
+        EXPECT_EQ(pos, (int)ts.GetTile(exp).pos);
+      }
+      const int many_pos[4] = { pos, pos - 1, pos + 1, pos - BOARD_X };
+      int exp_many[4];
+      ts.FindMany(many_pos, 4, exp_many);
+      for (int impl = 1; impl < NUM_FIND_IMPLS; ++impl) {
+        if (!SetFindImpl(FindImpl(impl))) continue;
+        EXPECT_EQ(exp, ts.Find(pos)) << FindImplName(FindImpl(impl));
+        for (int num = 1; num <= 4; ++num) {
+          int many[4] = { -2, -2, -2, -2 };
+          ts.FindMany(many_pos, num, many);
+          for (int k = 0; k < 4; ++k) {
+            EXPECT_EQ(k < num ? exp_many[k] : -2, many[k])
+                << FindImplName(FindImpl(impl));
+          }
+        }
+      }
+    }
+    SetFindImpl(orig);
+    State n;
+    const int res = s.Move(b, rand() % s.NumTiles(), rand() % 4, &n);
+    n.ClearHistory();
+    s = res == 0 ? n : State(B);
+  }
+  EXPECT_EQ(orig, GetFindImpl());
+}
+
+TEST(TestState, MoveOccupied) {
+  const char B[] =
+    "##########"
+    "#a e e e #"
+    "#        #"
+    "#hjhjhjh #"
+    "#  b     #"
+    "#c   f   #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  srand(1);
+  int num_slides = 0;
+  for (int step = 0; step < 200; ++step) {
+    State::Cells occupied;
+    s.GetOccupied(&occupied);
+    for (int ti = 0; ti < s.NumTiles(); ++ti) {
+      if (!MOVEABLE[s.GetTile(ti).type]) continue;
+      for (int dir = 0; dir < 4; ++dir) {
+        State exp, n;
+        int exp_len, len;
+        const int exp_res = s.Move(b, ti, dir, &exp, &exp_len);
+        EXPECT_EQ(exp_res, s.Move(b, ti, dir, occupied, &n, &len));
+        if (exp_res != 0) continue;
+        EXPECT_EQ(exp_len, len);
+        if (len > 0) ++num_slides;
+        ASSERT_EQ(exp.NumTiles(), n.NumTiles()) << b.DebugStringWithState(s);
+        for (int i = 0; i < n.NumTiles(); ++i) {
+          EXPECT_EQ(exp.GetTile(i).pos, n.GetTile(i).pos);
+          EXPECT_EQ(exp.GetTile(i).type, n.GetTile(i).type);
+        }
+        ASSERT_EQ(exp.GetHistoryLen(), n.GetHistoryLen());
+        EXPECT_EQ(ti, n.GetHistory()[n.GetHistoryLen() - 1].tile_index);
+        EXPECT_EQ(dir, n.GetHistory()[n.GetHistoryLen() - 1].dir);
+      }
+    }
+    State n;
+    const int res = s.Move(b, rand() % s.NumTiles(), rand() % 4, &n);
+    n.ClearHistory();
+    s = res == 0 ? n : State(B);
+  }
+  EXPECT_LT(0, num_slides);
+  EXPECT_LT(0, b.SlideCacheHits());
+  EXPECT_LT(b.SlideCacheHits(), b.SlideCacheLookups());
+}
+
 // static const char B003[] =
 //     "##########"
 //     "#    c c #"
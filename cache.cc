@@ -0,0 +1,258 @@
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+
+#include "cache.h"
+#include "log.h"
+#include "utils.h"
+
+using namespace std;
+
+// Start of a cache file, followed by the slots.
+struct SolutionCacheHeader {
+  char magic[8];
+  int capacity;
+  int reserved;
+};
+
+static const char SOLUTION_CACHE_MAGIC[8] = "GTNSC01";
+
+int MirrorPos(int pos, int orientation, int board_x, int width, int height) {
+  int x = pos % board_x - 1;
+  int y = pos / board_x - 1;
+  if (x < 0 || x >= width || y < 0 || y >= height) return pos;
+  if (orientation & 1) x = width - 1 - x;
+  if (orientation & 2) y = height - 1 - y;
+  return (y + 1) * board_x + x + 1;
+}
+
+int MirrorDir(int dir, int orientation) {
+  // UP, LEFT, RIGHT, DOWN are 0, 1, 2, 3.
+  if ((orientation & 1) && (dir == 1 || dir == 2)) return 3 - dir;
+  if ((orientation & 2) && (dir == 0 || dir == 3)) return 3 - dir;
+  return dir;
+}
+
+int CanonicalOrientation(const string& board, int board_x, int width,
+                         int height, string* canonical) {
+  int best = 0;
+  *canonical = board;
+  for (int o = 1; o < NUM_ORIENTATIONS; ++o) {
+    string mirrored = board;
+    for (int pos = 0; pos < (int)board.size(); ++pos) {
+      mirrored[MirrorPos(pos, o, board_x, width, height)] = board[pos];
+    }
+    if (mirrored < *canonical) {
+      best = o;
+      *canonical = mirrored;
+    }
+  }
+  return best;
+}
+
+int SolutionKey(const Rules& rules, const string& board, int board_x,
+                int board_y, int width, int height,
+                unsigned long long key[2]) {
+  string canonical;
+  const int orientation =
+      CanonicalOrientation(board, board_x, width, height, &canonical);
+  const int meta[] = { SOLUTION_CACHE_VERSION, board_x, board_y };
+  const unsigned long long rules_hash = rules.Fingerprint();
+  unsigned long long h = HashBytes(canonical.data(), canonical.size());
+  h = HashBytes(meta, sizeof(meta), h);
+  h = HashBytes(&rules_hash, sizeof(rules_hash), h);
+  key[0] = h | 1;
+  key[1] = HashBytes(canonical.data(), canonical.size(), h);
+  return orientation;
+}
+
+SolutionCache::SolutionCache()
+  : data(NULL), size(0), capacity(0), slots(NULL) {}
+
+SolutionCache::~SolutionCache() {
+  Close();
+}
+
+bool SolutionCache::Open(const string& path, int new_capacity) {
+  Close();
+  int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  if (st.st_size == 0) {
+    // New file, the slots are all zero, that is empty.
+    SolutionCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SOLUTION_CACHE_MAGIC, sizeof(header.magic));
+    header.capacity = new_capacity;
+    st.st_size =
+        sizeof(header) + (long long)new_capacity * sizeof(CachedSolution);
+    if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+        ftruncate(fd, st.st_size) != 0) {
+      close(fd);
+      return false;
+    }
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return false;
+  data = p;
+  size = st.st_size;
+  const SolutionCacheHeader* header = (const SolutionCacheHeader*)data;
+  if (size < (long long)sizeof(*header) ||
+      memcmp(header->magic, SOLUTION_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->capacity <= 0 ||
+      size != (long long)sizeof(*header) +
+              (long long)header->capacity * (long long)sizeof(CachedSolution)) {
+    Close();
+    return false;
+  }
+  capacity = header->capacity;
+  slots = (CachedSolution*)(header + 1);
+  return true;
+}
+
+void SolutionCache::Close() {
+  if (data != NULL) munmap(data, size);
+  data = NULL;
+  size = 0;
+  capacity = 0;
+  slots = NULL;
+}
+
+int SolutionCache::Find(const unsigned long long key[2]) const {
+  if (slots == NULL) return -1;
+  int slot = key[1] % capacity;
+  for (int i = 0; i < capacity; ++i) {
+    const CachedSolution& s = slots[slot];
+    if ((s.key[0] == key[0] && s.key[1] == key[1]) || s.key[0] == 0) {
+      return slot;
+    }
+    slot = (slot + 1) % capacity;
+  }
+  return -1;
+}
+
+bool SolutionCache::Lookup(const unsigned long long key[2],
+                           CachedSolution* sol) const {
+  const int slot = Find(key);
+  if (slot < 0 || slots[slot].key[0] == 0) return false;
+  *sol = slots[slot];
+  return true;
+}
+
+bool SolutionCache::Insert(const CachedSolution& sol) {
+  const int slot = Find(sol.key);
+  if (slot < 0) return false;
+  slots[slot] = sol;
+  return true;
+}
+
+int SolutionCache::Size() const {
+  int n = 0;
+  for (int i = 0; i < capacity; ++i) n += slots[i].key[0] != 0;
+  return n;
+}
+
+// Plays sol on start, the level flipped by orientation. Returns false if the
+// moves don't win on this board.
+template <class G>
+static bool ReplayCached(const CachedSolution& sol, int orientation,
+                         int width, int height, const BasicBoard<G>& board,
+                         const BasicState<G>& start,
+                         BasicSolveResult<G>* res) {
+  typedef BasicState<G> State;
+  res->num_moves = sol.stats[0];
+  res->max_mem_state = sol.stats[1];
+  res->num_visited_states = sol.stats[2];
+  res->num_visited_hit_improve = sol.stats[3];
+  res->num_visited_hit_drop = sol.stats[4];
+  if (sol.num_moves < 0) {
+    res->lower_bound = MAX_MOVES;
+    return true;
+  }
+  if (sol.num_moves > MAX_HISTORY) return false;
+  State curr = start;
+  for (int i = 0; i < sol.num_moves; ++i) {
+    const int pos = MirrorPos(sol.moves[i][0], orientation, G::BOARD_X, width,
+                              height);
+    const int dir = MirrorDir(sol.moves[i][1], orientation);
+    int tile_index = -1;
+    for (int t = 0; t < curr.NumTiles(); ++t) {
+      if (curr.GetTile(t).pos == pos && MOVEABLE[curr.GetTile(t).type]) {
+        tile_index = t;
+      }
+    }
+    if (tile_index < 0) return false;
+    State next;
+    const int move_res = curr.Move(board, tile_index, dir, &next);
+    if (move_res != (i + 1 == sol.num_moves ? State::WIN : 0)) return false;
+    curr = next;
+  }
+  res->success = true;
+  res->status = SOLVED;
+  res->lower_bound = sol.num_moves;
+  res->end_state = curr;
+  return true;
+}
+
+template <class G>
+BasicSolveResult<G> SolveCached(SolutionCache* cache, const Rules& rules,
+                                const BasicBoard<G>& board,
+                                const BasicState<G>& start, const char* bc,
+                                int width, int height,
+                                const SolveOptions& options) {
+  typedef BasicState<G> State;
+  if (cache == NULL) return solve(board, start, options);
+  CachedSolution sol;
+  memset(&sol, 0, sizeof(sol));
+  const int orientation =
+      SolutionKey(rules, string(bc, G::BOARD_SIZE), G::BOARD_X, G::BOARD_Y,
+                  width, height, sol.key);
+
+  CachedSolution cached;
+  if (cache->Lookup(sol.key, &cached)) {
+    BasicSolveResult<G> res;
+    if (ReplayCached(cached, orientation, width, height, board, start, &res)) {
+      LOG(1) << "cache hit, orientation " << orientation << endl;
+      return res;
+    }
+    LOG(1) << "cached solution doesn't replay, solving" << endl;
+  }
+
+  const BasicSolveResult<G> res = solve(board, start, options);
+  if (res.status != SOLVED && res.status != NO_SOLUTION) return res;
+  sol.num_moves = res.success ? res.end_state.GetHistoryLen() : -1;
+  sol.stats[0] = res.num_moves;
+  sol.stats[1] = res.max_mem_state;
+  sol.stats[2] = res.num_visited_states;
+  sol.stats[3] = res.num_visited_hit_improve;
+  sol.stats[4] = res.num_visited_hit_drop;
+  const typename State::HistoryItem* history = res.end_state.GetHistory();
+  State curr = start;
+  for (int i = 0; i < sol.num_moves; ++i) {
+    const Tile& tile = curr.GetTile(history[i].tile_index);
+    sol.moves[i][0] =
+        MirrorPos(tile.pos, orientation, G::BOARD_X, width, height);
+    sol.moves[i][1] = MirrorDir(history[i].dir, orientation);
+    State next;
+    curr.Move(board, history[i].tile_index, history[i].dir, &next);
+    curr = next;
+  }
+  if (!cache->Insert(sol)) LOG(1) << "solution cache full" << endl;
+  return res;
+}
+
+#define INSTANTIATE(G)                                                   \
+  template BasicSolveResult<G> SolveCached<G>(                           \
+      SolutionCache*, const Rules&, const BasicBoard<G>&,                \
+      const BasicState<G>&, const char*, int, int, const SolveOptions&);
+GTN_FOR_EACH_GEOMETRY(INSTANTIATE)
+#undef INSTANTIATE
@@ -0,0 +1,96 @@
+#ifndef _GTN_CACHE_H__
+#define _GTN_CACHE_H__
+
+#include <string>
+
+#include "board.h"
+#include "rules.h"
+#include "solve.h"
+
+// Bump when a solver change alters its solutions or stats, so that cached
+// results of older solvers are ignored.
+static const int SOLUTION_CACHE_VERSION = 1;
+
+// Slots of a new cache file, about 2MB.
+static const int DEFAULT_CACHE_CAPACITY = 1 << 14;
+
+// Orientations of a level: bit 0 flips it left to right, bit 1 upside down.
+static const int NUM_ORIENTATIONS = 4;
+
+// Cell pos of a board board_x wide, with a level of width x height cells in
+// its top left corner, after flipping the level by orientation. Walls around
+// the level stay in place. Every orientation is its own inverse.
+int MirrorPos(int pos, int orientation, int board_x, int width, int height);
+// Direction dir of a move after flipping the board by orientation.
+int MirrorDir(int dir, int orientation);
+
+// The orientation that gives the smallest layout of board, which must be
+// board_x * board_y cells, and that layout.
+int CanonicalOrientation(const std::string& board, int board_x, int width,
+                         int height, std::string* canonical);
+
+// Cache key of board, a board_x * board_y layout with a level of width x
+// height cells, under rules. Mirrored levels get the same key. Returns the
+// orientation that maps board to the layout cached solutions are stored in.
+int SolutionKey(const Rules& rules, const std::string& board, int board_x,
+                int board_y, int width, int height,
+                unsigned long long key[2]);
+
+// Solution of a level, or the lack of one, and the stats of the solve.
+struct CachedSolution {
+  // Of the canonical layout, the rules and SOLUTION_CACHE_VERSION. Never 0.
+  unsigned long long key[2];
+  // Solution length, -1 if there is none.
+  int num_moves;
+  int stats[5];
+  // Position of the moving tile and direction of each move, in the canonical
+  // orientation.
+  unsigned char moves[MAX_HISTORY][2];
+};
+
+// Open addressed hash table of CachedSolution in a memory mapped file. It is
+// not safe to share between processes writing at the same time.
+class SolutionCache {
+ public:
+  SolutionCache();
+  ~SolutionCache();
+
+  // Maps path, creating it with capacity slots if needed. Returns false if
+  // the file can't be created or isn't a cache.
+  bool Open(const std::string& path, int capacity = DEFAULT_CACHE_CAPACITY);
+  void Close();
+
+  bool Lookup(const unsigned long long key[2], CachedSolution* sol) const;
+  // Adds or replaces the solution of sol.key. Returns false if the cache is
+  // full.
+  bool Insert(const CachedSolution& sol);
+
+  int Capacity() const { return capacity; }
+  int Size() const;
+
+ private:
+  // Slot of key, or of the empty slot it would go to. -1 if full.
+  int Find(const unsigned long long key[2]) const;
+
+  void* data;
+  long long size;
+  int capacity;
+  CachedSolution* slots;
+
+  // Not copyable, owns the mapping.
+  SolutionCache(const SolutionCache&);
+  void operator=(const SolutionCache&);
+};
+
+// solve() with a cache: looks up the level bc, a board of width x height
+// cells, in every orientation and replays the cached solution on the actual
+// board. Solves with options and stores the result if nothing is cached or
+// the replay fails, unless a limit stopped the solve. cache may be NULL.
+template <class G>
+BasicSolveResult<G> SolveCached(SolutionCache* cache, const Rules& rules,
+                                const BasicBoard<G>& board,
+                                const BasicState<G>& start, const char* bc,
+                                int width, int height,
+                                const SolveOptions& options = SolveOptions());
+
+#endif // _GTN_CACHE_H__
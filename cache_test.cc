@@ -0,0 +1,143 @@
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+#include "board.h"
+#include "cache.h"
+#include "rules.h"
+#include "solve.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+#include "testboards.h"
+
+static const Rules REAL_RULES = Rules("rules-real.csv");
+
+static const char CACHE_PATH[] = "/tmp/gtn_cache_test.cache";
+
+// bs flipped by orientation, the level is the 8x6 cells inside the walls.
+string Mirror(const char* bs, int orientation) {
+  string m(bs);
+  for (int pos = 0; pos < BOARD_SIZE; ++pos) {
+    m[MirrorPos(pos, orientation, BOARD_X, 8, 6)] = bs[pos];
+  }
+  return m;
+}
+
+TEST(TestCache, Mirror) {
+  for (int o = 0; o < NUM_ORIENTATIONS; ++o) {
+    for (int pos = 0; pos < BOARD_SIZE; ++pos) {
+      EXPECT_EQ(pos, MirrorPos(MirrorPos(pos, o, BOARD_X, 8, 6), o,
+                               BOARD_X, 8, 6));
+    }
+    for (int dir = 0; dir < 4; ++dir) {
+      EXPECT_EQ(dir, MirrorDir(MirrorDir(dir, o), o));
+    }
+  }
+  // Walls stay.
+  EXPECT_EQ(0, MirrorPos(0, 3, BOARD_X, 8, 6));
+  EXPECT_EQ(POS(1, 8), MirrorPos(POS(1, 1), 1, BOARD_X, 8, 6));
+  EXPECT_EQ(POS(6, 1), MirrorPos(POS(1, 1), 2, BOARD_X, 8, 6));
+  EXPECT_EQ(State::RIGHT, MirrorDir(State::LEFT, 1));
+  EXPECT_EQ(State::LEFT, MirrorDir(State::LEFT, 2));
+  EXPECT_EQ(State::DOWN, MirrorDir(State::UP, 2));
+
+  string canonical;
+  CanonicalOrientation(B003, BOARD_X, 8, 6, &canonical);
+  for (int o = 0; o < NUM_ORIENTATIONS; ++o) {
+    string c;
+    CanonicalOrientation(Mirror(B003, o), BOARD_X, 8, 6, &c);
+    EXPECT_EQ(canonical, c);
+  }
+}
+
+TEST(TestCache, Persistent) {
+  unlink(CACHE_PATH);
+  CachedSolution sol;
+  memset(&sol, 0, sizeof(sol));
+  sol.key[0] = 7;
+  sol.key[1] = 42;
+  sol.num_moves = 3;
+  {
+    SolutionCache cache;
+    ASSERT_TRUE(cache.Open(CACHE_PATH, 8));
+    EXPECT_EQ(0, cache.Size());
+    EXPECT_FALSE(cache.Lookup(sol.key, &sol));
+    EXPECT_TRUE(cache.Insert(sol));
+  }
+  SolutionCache cache;
+  // The capacity of an existing file wins.
+  ASSERT_TRUE(cache.Open(CACHE_PATH, 100));
+  EXPECT_EQ(8, cache.Capacity());
+  EXPECT_EQ(1, cache.Size());
+  CachedSolution found;
+  ASSERT_TRUE(cache.Lookup(sol.key, &found));
+  EXPECT_EQ(3, found.num_moves);
+  for (int i = 1; i < 8; ++i) {
+    sol.key[0] = 7 + 2 * i;
+    EXPECT_TRUE(cache.Insert(sol));
+  }
+  sol.key[0] = 1;
+  EXPECT_FALSE(cache.Insert(sol));
+  unlink(CACHE_PATH);
+}
+
+// Solves bs through cache and checks the solution length by replaying it.
+void CheckCachedSolve(SolutionCache* cache, const string& bs, int exp_moves,
+                      int exp_num_moves_stat) {
+  Board b(bs.c_str(), REAL_RULES);
+  State s(bs.c_str());
+  const SolveResult res =
+      SolveCached(cache, REAL_RULES, b, s, bs.c_str(), 8, 6);
+  ASSERT_TRUE(res.success);
+  ASSERT_EQ(exp_moves, res.end_state.GetHistoryLen());
+  EXPECT_EQ(exp_num_moves_stat, res.num_moves);
+  State curr = s;
+  for (int i = 0; i < exp_moves; ++i) {
+    const State::HistoryItem& h = res.end_state.GetHistory()[i];
+    State next;
+    EXPECT_EQ(i + 1 == exp_moves ? State::WIN : 0,
+              curr.Move(b, h.tile_index, h.dir, &next));
+    curr = next;
+  }
+}
+
+TEST(TestCache, SolveMirrored) {
+  unlink(CACHE_PATH);
+  SolutionCache cache;
+  ASSERT_TRUE(cache.Open(CACHE_PATH));
+  const SolveResult fresh = solve(Board(B003, REAL_RULES), State(B003));
+  CheckCachedSolve(&cache, B003, 6, fresh.num_moves);
+  EXPECT_EQ(1, cache.Size());
+  // The mirrored levels replay the stats of the first solve.
+  for (int o = 1; o < NUM_ORIENTATIONS; ++o) {
+    CheckCachedSolve(&cache, Mirror(B003, o), 6, fresh.num_moves);
+  }
+  EXPECT_EQ(1, cache.Size());
+  CheckCachedSolve(&cache, B004, 6,
+                   solve(Board(B004, REAL_RULES), State(B004)).num_moves);
+  EXPECT_EQ(2, cache.Size());
+  unlink(CACHE_PATH);
+}
+
+TEST(TestCache, BrokenEntryIsSolvedAgain) {
+  unlink(CACHE_PATH);
+  SolutionCache cache;
+  ASSERT_TRUE(cache.Open(CACHE_PATH));
+  const SolveResult fresh = solve(Board(B003, REAL_RULES), State(B003));
+  CheckCachedSolve(&cache, B003, 6, fresh.num_moves);
+  // Break the stored solution: the replay fails and the level is solved.
+  CachedSolution sol;
+  SolutionKey(REAL_RULES, B003, BOARD_X, BOARD_Y, 8, 6, sol.key);
+  ASSERT_TRUE(cache.Lookup(sol.key, &sol));
+  EXPECT_EQ(6, sol.num_moves);
+  sol.moves[0][1] = 3 - sol.moves[0][1];
+  sol.stats[0] = -1;
+  EXPECT_TRUE(cache.Insert(sol));
+  CheckCachedSolve(&cache, B003, 6, fresh.num_moves);
+  ASSERT_TRUE(cache.Lookup(sol.key, &sol));
+  EXPECT_EQ(fresh.num_moves, sol.stats[0]);
+  unlink(CACHE_PATH);
+}
@@ -0,0 +1,28 @@
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "server.h"
+
+using namespace std;
+
+// solve_client socket < requests
+// Sends the JSON line requests on stdin to a solve_server and prints the
+// answers.
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    cout << "Usage: solve_client socket < requests" << endl;
+    exit(2);
+  }
+  vector<string> lines;
+  string line;
+  while (getline(cin, line)) lines.push_back(line);
+  vector<string> answers;
+  if (!SendRequests(argv[1], lines, &answers)) {
+    cout << "Can't talk to " << argv[1] << endl;
+    exit(2);
+  }
+  for (size_t i = 0; i < answers.size(); ++i) cout << answers[i] << endl;
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <new>
+
+#include "concurrent_visited.h"
+
+static inline unsigned __int128 ToWide(const StateKey<2>& key) {
+  return ((unsigned __int128)key.w[0] << 64) | key.w[1];
+}
+
+// Reads a slot key. A key goes from 0 to its value in one compare and swap,
+// so halves that are both set are the key. A single 0 half may have been read
+// before the swap, then the key is read again by a compare and swap that
+// writes nothing new.
+static inline unsigned __int128 LoadKey(unsigned __int128* key) {
+  const unsigned long long* halves = (const unsigned long long*)key;
+  const unsigned long long low = __atomic_load_n(&halves[0], __ATOMIC_ACQUIRE);
+  const unsigned long long high =
+      __atomic_load_n(&halves[1], __ATOMIC_ACQUIRE);
+  if (low == 0 && high == 0) return 0;
+  if (low != 0 && high != 0) return ((unsigned __int128)high << 64) | low;
+  return __sync_val_compare_and_swap(key, 0, 0);
+}
+
+ConcurrentVisitedTable::ConcurrentVisitedTable(long long max_entries,
+                                               bool huge_pages)
+  : num_slots(1), shift(64), zero_key_g(0) {
+  while ((long long)num_slots < 2 * max_entries) {
+    num_slots *= 2;
+    --shift;
+  }
+  if (!buffer.Allocate(num_slots * sizeof(Slot), huge_pages)) {
+    throw std::bad_alloc();
+  }
+}
+
+// The top bits of a multiplicative hash, as in VisitedTable.
+size_t ConcurrentVisitedTable::Index(unsigned __int128 key) const {
+  if (shift == 64) return 0;
+  unsigned long long h = (key >> 64) * 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 32;
+  h = (h ^ (unsigned long long)key) * 0x9E3779B97F4A7C15ULL;
+  h ^= h >> 32;
+  return (h * 0x9E3779B97F4A7C15ULL) >> shift;
+}
+
+ConcurrentVisitedTable::Outcome ConcurrentVisitedTable::LowerG(
+    int* stored_g, int g, int* prev_g) {
+  int curr = __atomic_load_n(stored_g, __ATOMIC_ACQUIRE);
+  while (true) {
+    if (curr != 0 && curr <= g + 1) {
+      if (prev_g != NULL) *prev_g = curr - 1;
+      return NOT_IMPROVED;
+    }
+    // On failure curr gets the g another thread stored.
+    if (__atomic_compare_exchange_n(stored_g, &curr, g + 1, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      if (curr == 0) return INSERTED;
+      if (prev_g != NULL) *prev_g = curr - 1;
+      return IMPROVED;
+    }
+  }
+}
+
+ConcurrentVisitedTable::Outcome ConcurrentVisitedTable::InsertOrImprove(
+    const Key& key, int g, int* prev_g) {
+  const unsigned __int128 k = ToWide(key);
+  if (k == 0) return LowerG(&zero_key_g, g, prev_g);
+  Slot* s = slots();
+  size_t i = Index(k);
+  for (size_t probes = 0; probes < num_slots;
+       ++probes, i = (i + 1) & (num_slots - 1)) {
+    unsigned __int128 curr = LoadKey(&s[i].key);
+    // Claim the empty slot, or see which key beat us to it.
+    if (curr == 0) curr = __sync_val_compare_and_swap(&s[i].key, 0, k);
+    if (curr == 0 || curr == k) return LowerG(&s[i].g, g, prev_g);
+  }
+  return FULL;
+}
+
+bool ConcurrentVisitedTable::Find(const Key& key, int* g) const {
+  const unsigned __int128 k = ToWide(key);
+  int stored;
+  if (k == 0) {
+    stored = __atomic_load_n(&zero_key_g, __ATOMIC_ACQUIRE);
+  } else {
+    Slot* s = slots();
+    size_t i = Index(k);
+    for (size_t probes = 0;; ++probes, i = (i + 1) & (num_slots - 1)) {
+      if (probes == num_slots) return false;
+      const unsigned __int128 curr = LoadKey(&s[i].key);
+      if (curr == 0) return false;
+      if (curr == k) break;
+    }
+    stored = __atomic_load_n(&s[i].g, __ATOMIC_ACQUIRE);
+  }
+  if (stored == 0) return false;
+  *g = stored - 1;
+  return true;
+}
+
+long long ConcurrentVisitedTable::size() const {
+  long long n = __atomic_load_n(&zero_key_g, __ATOMIC_ACQUIRE) != 0;
+  const Slot* s = slots();
+  for (size_t i = 0; i < num_slots; ++i) {
+    n += __atomic_load_n(&s[i].g, __ATOMIC_ACQUIRE) != 0;
+  }
+  return n;
+}
@@ -0,0 +1,74 @@
+#ifndef _GTN_CONCURRENT_VISITED_H__
+#define _GTN_CONCURRENT_VISITED_H__
+
+#include "board.h"
+#include "pages.h"
+
+// Visited states shared by the threads of a parallel search: 128 bit keys
+// and the g (moves from the start) of each, in an open addressing table with
+// linear probing. Lock-free, a thread claims an empty slot with a 128 bit
+// compare and swap of the key and lowers g with a compare and swap loop.
+// Keys are never removed, so a claimed slot keeps its key.
+//
+// The size is fixed, InsertOrImprove() returns FULL when every slot of the
+// probe is taken. Needs cmpxchg16b, concurrent_visited.cc is compiled with
+// -mcx16.
+class ConcurrentVisitedTable {
+ public:
+  typedef StateKey<2> Key;
+
+  enum Outcome {
+    // The key was new.
+    INSERTED,
+    // The key had a bigger g, which is now the new one.
+    IMPROVED,
+    // The key had the same g or a smaller one, it is kept.
+    NOT_IMPROVED,
+    FULL,
+  };
+
+  // Room for max_entries keys at a load of at most one half. Throws
+  // std::bad_alloc if the slots can't be mapped.
+  explicit ConcurrentVisitedTable(long long max_entries,
+                                  bool huge_pages = false);
+
+  // Sets the g of key to g, at least 0, if it is new or g is smaller, as
+  // solve() does with a state it generates. prev_g, if not NULL, gets the g
+  // before unless the key was new. Safe to call from any number of threads.
+  Outcome InsertOrImprove(const Key& key, int g, int* prev_g);
+
+  // Whether key is there, g gets its g. Keys still being inserted by another
+  // thread may not be found yet.
+  bool Find(const Key& key, int* g) const;
+
+  // Keys with a g, counted over the slots. Only exact when no thread is
+  // inserting.
+  long long size() const;
+  long long Bytes() const { return (long long)num_slots * sizeof(Slot); }
+  PageKind Pages() const { return buffer.kind(); }
+
+ private:
+  // The key is written by one compare and swap, 0 is empty. g is stored plus
+  // one, 0 until the thread that claimed the slot or found it sets it.
+  struct Slot {
+    unsigned __int128 key;
+    int g;
+    int pad_[3];
+  };
+
+  Slot* slots() const { return (Slot*)buffer.data(); }
+  size_t Index(unsigned __int128 key) const;
+  // Lowers *stored_g to g + 1 if it is unset or bigger.
+  static Outcome LowerG(int* stored_g, int g, int* prev_g);
+
+  PageBuffer buffer;
+  size_t num_slots;
+  int shift;
+  // The key 0 can't be stored in a slot, its g lives here.
+  int zero_key_g;
+
+  ConcurrentVisitedTable(const ConcurrentVisitedTable&);
+  ConcurrentVisitedTable& operator=(const ConcurrentVisitedTable&);
+};
+
+#endif // _GTN_CONCURRENT_VISITED_H__
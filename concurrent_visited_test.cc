@@ -0,0 +1,102 @@
+#include <map>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "concurrent_visited.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+typedef ConcurrentVisitedTable Table;
+
+static StateKey<2> MakeKey(unsigned long long a, unsigned long long b) {
+  StateKey<2> key;
+  key.w[0] = a;
+  key.w[1] = b;
+  return key;
+}
+
+TEST(TestConcurrentVisited, InsertOrImprove) {
+  Table table(100);
+  int g = -1;
+  EXPECT_FALSE(table.Find(MakeKey(1, 2), &g));
+  EXPECT_EQ(Table::INSERTED, table.InsertOrImprove(MakeKey(1, 2), 5, &g));
+  ASSERT_TRUE(table.Find(MakeKey(1, 2), &g));
+  EXPECT_EQ(5, g);
+  EXPECT_EQ(Table::NOT_IMPROVED, table.InsertOrImprove(MakeKey(1, 2), 5, &g));
+  EXPECT_EQ(5, g);
+  EXPECT_EQ(Table::IMPROVED, table.InsertOrImprove(MakeKey(1, 2), 3, &g));
+  EXPECT_EQ(5, g);
+  ASSERT_TRUE(table.Find(MakeKey(1, 2), &g));
+  EXPECT_EQ(3, g);
+  // Keys with a 0 half, and the 0 key.
+  EXPECT_EQ(Table::INSERTED, table.InsertOrImprove(MakeKey(1, 0), 0, NULL));
+  EXPECT_EQ(Table::INSERTED, table.InsertOrImprove(MakeKey(0, 2), 1, NULL));
+  EXPECT_FALSE(table.Find(MakeKey(0, 0), &g));
+  EXPECT_EQ(Table::INSERTED, table.InsertOrImprove(MakeKey(0, 0), 7, NULL));
+  EXPECT_EQ(Table::IMPROVED, table.InsertOrImprove(MakeKey(0, 0), 6, &g));
+  EXPECT_EQ(7, g);
+  ASSERT_TRUE(table.Find(MakeKey(1, 0), &g));
+  EXPECT_EQ(0, g);
+  ASSERT_TRUE(table.Find(MakeKey(0, 2), &g));
+  EXPECT_EQ(1, g);
+  EXPECT_EQ(4, table.size());
+  EXPECT_EQ(256 * 32, table.Bytes());
+}
+
+TEST(TestConcurrentVisited, Full) {
+  Table table(1);
+  EXPECT_EQ(Table::INSERTED, table.InsertOrImprove(MakeKey(1, 1), 0, NULL));
+  EXPECT_EQ(Table::INSERTED, table.InsertOrImprove(MakeKey(2, 2), 5, NULL));
+  EXPECT_EQ(Table::FULL, table.InsertOrImprove(MakeKey(3, 3), 0, NULL));
+  // Known keys are still improved.
+  EXPECT_EQ(Table::IMPROVED, table.InsertOrImprove(MakeKey(2, 2), 4, NULL));
+  int g;
+  EXPECT_FALSE(table.Find(MakeKey(3, 3), &g));
+}
+
+// Threads insert the same keys with different g, as parallel expansions
+// reaching a state by different paths. Run it under ThreadSanitizer with
+// make concurrent_visited_tsan_test.
+TEST(TestConcurrentVisited, Threads) {
+  const int num_threads = 8;
+  const int num_keys = 20000;
+  Table table(num_keys);
+  vector<vector<int> > outcomes(num_threads, vector<int>(Table::FULL + 1));
+  vector<thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.push_back(thread([&, t]() {
+      for (int i = 0; i < num_keys; ++i) {
+        // Each thread walks the keys in its own order.
+        const int k = (i * 7919 + t * 104729) % num_keys;
+        const StateKey<2> key = MakeKey((unsigned long long)k << 40, k % 5);
+        ++outcomes[t][table.InsertOrImprove(key, (k + t) % num_threads + 1,
+                                             NULL)];
+      }
+    }));
+  }
+  for (int t = 0; t < num_threads; ++t) threads[t].join();
+  vector<int> total(Table::FULL + 1);
+  for (int t = 0; t < num_threads; ++t) {
+    for (int o = 0; o <= Table::FULL; ++o) total[o] += outcomes[t][o];
+  }
+  // Every key is inserted once and ends with the smallest g.
+  EXPECT_EQ(num_keys, total[Table::INSERTED]);
+  EXPECT_EQ(0, total[Table::FULL]);
+  EXPECT_EQ(num_threads * num_keys, total[Table::INSERTED] +
+            total[Table::IMPROVED] + total[Table::NOT_IMPROVED]);
+  EXPECT_EQ(num_keys, table.size());
+  for (int k = 0; k < num_keys; ++k) {
+    int g;
+    ASSERT_TRUE(table.Find(MakeKey((unsigned long long)k << 40, k % 5), &g));
+    ASSERT_EQ(1, g);
+  }
+}
+
+TEST(TestConcurrentVisited, OutOfMemory) {
+  // 2^46 slots of 32 bytes, more than the address space.
+  EXPECT_THROW(ConcurrentVisitedTable table(1LL << 45), std::bad_alloc);
+}
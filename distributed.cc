@@ -0,0 +1,853 @@
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "distributed.h"
+#include "level.h"
+#include "rules.h"
+#include "solve.h"
+#include "utils.h"
+#include "visited.h"
+
+using namespace std;
+
+static const Rules REAL_RULES = Rules("rules-real.csv");
+
+// Successors per message.
+static const int BATCH_STATES = 256;
+// Sent in the handshake, peers must speak the same.
+static const int PROTOCOL_VERSION = 1;
+// Larger messages are a broken peer.
+static const int MAX_MESSAGE_BYTES = 1 << 20;
+// How long a worker waits for its peers to come up.
+static const long long CONNECT_TIMEOUT_US = 10 * 1000000LL;
+
+DistributedResult::DistributedResult()
+  : status(NO_SOLUTION),
+    length(-1),
+    lower_bound(0),
+    num_expanded(0),
+    num_visited_states(0),
+    states_sent(0),
+    states_received(0),
+    visited_bytes(0),
+    num_rounds(0) {}
+
+////////////////////////////////////////////////////////////////////////////////
+// Sockets
+////////////////////////////////////////////////////////////////////////////////
+
+static bool WriteAll(int fd, const void* data, size_t size) {
+  const char* p = (const char*)data;
+  while (size > 0) {
+    const ssize_t n = write(fd, p, size);
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// WriteAll() for sockets. A peer that went away fails the send instead of
+// raising SIGPIPE.
+static bool SendAll(int fd, const void* data, size_t size) {
+  const char* p = (const char*)data;
+  while (size > 0) {
+    const ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool ReadAll(int fd, void* data, size_t size) {
+  char* p = (char*)data;
+  while (size > 0) {
+    const ssize_t n = read(fd, p, size);
+    if (n <= 0) return false;
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Addresses of "host:port".
+static addrinfo* Resolve(const string& address, bool passive) {
+  const size_t colon = address.rfind(':');
+  if (colon == string::npos) return NULL;
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  if (passive) hints.ai_flags = AI_PASSIVE;
+  addrinfo* info = NULL;
+  if (getaddrinfo(address.substr(0, colon).c_str(),
+                  address.substr(colon + 1).c_str(), &hints, &info) != 0) {
+    return NULL;
+  }
+  return info;
+}
+
+int ListenTcp(const string& address, int* port) {
+  addrinfo* info = Resolve(address, true);
+  if (info == NULL) return -1;
+  const int fd = socket(info->ai_family, SOCK_STREAM, 0);
+  const int one = 1;
+  if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  const bool ok = fd >= 0 && bind(fd, info->ai_addr, info->ai_addrlen) == 0 &&
+                  listen(fd, 64) == 0;
+  freeaddrinfo(info);
+  if (!ok) {
+    if (fd >= 0) close(fd);
+    return -1;
+  }
+  if (port != NULL) {
+    sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &len);
+    *port = ntohs(addr.sin_port);
+  }
+  return fd;
+}
+
+// Connects to address, retrying until deadline_us while the peer starts.
+static int ConnectTcp(const string& address, long long deadline_us) {
+  addrinfo* info = Resolve(address, false);
+  if (info == NULL) return -1;
+  int fd = -1;
+  while (true) {
+    fd = socket(info->ai_family, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, info->ai_addr, info->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+    if (NowMicros() > deadline_us) break;
+    usleep(10000);
+  }
+  freeaddrinfo(info);
+  return fd;
+}
+
+// Accepts a connection on listen_fd, -1 if none comes by deadline_us.
+static int AcceptTcp(int listen_fd, long long deadline_us) {
+  pollfd p;
+  p.fd = listen_fd;
+  p.events = POLLIN;
+  const long long wait_ms = (deadline_us - NowMicros()) / 1000;
+  if (wait_ms <= 0 || poll(&p, 1, wait_ms) != 1) return -1;
+  return accept(listen_fd, NULL, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Messages
+////////////////////////////////////////////////////////////////////////////////
+
+// Everything on the wire is little endian integers of a fixed size, so
+// workers on different hosts and builds agree. A message is its type and
+// payload size as 4 bytes each, then the payload.
+enum MessageType {
+  // Successors, see PutEntry().
+  MSG_STATES,
+  // A RoundSummary.
+  MSG_END_ROUND,
+  // Made up by Inbox when a peer closes its connection.
+  MSG_CLOSED,
+};
+
+static const int MESSAGE_HEADER_BYTES = 8;
+
+static void PutInt(unsigned long long value, int bytes, string* out) {
+  for (int i = 0; i < bytes; ++i) out->push_back((char)(value >> (8 * i)));
+}
+
+// Reads the integers of a payload in order. Reading past the end gives 0 and
+// clears ok.
+class PayloadReader {
+ public:
+  explicit PayloadReader(const string& data) : data(data), pos(0), ok(true) {}
+
+  unsigned long long Get(int bytes) {
+    if (pos + bytes > data.size()) {
+      ok = false;
+      return 0;
+    }
+    unsigned long long value = 0;
+    for (int i = 0; i < bytes; ++i) {
+      value |= (unsigned long long)(unsigned char)data[pos++] << (8 * i);
+    }
+    return value;
+  }
+  bool Done() const { return pos == data.size(); }
+  bool Ok() const { return ok; }
+
+ private:
+  const string& data;
+  size_t pos;
+  bool ok;
+};
+
+// What a worker did in a round, 16 bytes in that order.
+struct RoundSummary {
+  long long expanded;
+  // Length of its shortest win, MAX_MOVES without one.
+  int win_length;
+  // Lowest f in its open list, MAX_MOVES if it is empty.
+  int min_open;
+};
+
+static string EncodeSummary(const RoundSummary& summary) {
+  string out;
+  PutInt(summary.expanded, 8, &out);
+  PutInt(summary.win_length, 4, &out);
+  PutInt(summary.min_open, 4, &out);
+  return out;
+}
+
+static bool DecodeSummary(const string& data, RoundSummary* summary) {
+  PayloadReader in(data);
+  summary->expanded = in.Get(8);
+  summary->win_length = in.Get(4);
+  summary->min_open = in.Get(4);
+  return in.Ok() && in.Done() && summary->expanded >= 0 &&
+         summary->win_length >= 0 && summary->win_length <= MAX_MOVES &&
+         summary->min_open >= 0 && summary->min_open <= MAX_MOVES;
+}
+
+// The first bytes on a connection, from the worker that connects: the
+// protocol version, its rank and a hash of the level.
+static const int HANDSHAKE_BYTES = 16;
+
+static unsigned long long LevelHash(const Level& level) {
+  string rows;
+  for (size_t y = 0; y < level.size(); ++y) {
+    for (size_t x = 0; x < level[y].size(); ++x) rows += level[y][x] + ",";
+    rows += "\n";
+  }
+  return HashBytes(rows.data(), rows.size());
+}
+
+struct Message {
+  int from;
+  int type;
+  string data;
+};
+
+// The messages of every peer in the order they arrive. A thread reads all the
+// connections, so sending never waits on a peer that is sending too.
+class Inbox {
+ public:
+  explicit Inbox(const vector<int>& fds) : fds(fds) {
+    reader = thread(&Inbox::Read, this);
+  }
+  // Waits for the peers to close their connections.
+  ~Inbox() { reader.join(); }
+
+  // Waits for the next message. Every peer ends with a MSG_CLOSED.
+  void Pop(Message* message) {
+    unique_lock<mutex> lock(mu);
+    while (messages.empty()) cv.wait(lock);
+    *message = messages.front();
+    messages.pop_front();
+  }
+
+  // Pop() without the wait, false if there is no message.
+  bool TryPop(Message* message) {
+    lock_guard<mutex> lock(mu);
+    if (messages.empty()) return false;
+    *message = messages.front();
+    messages.pop_front();
+    return true;
+  }
+
+ private:
+  void Read() {
+    vector<pollfd> polls;
+    vector<int> ranks;
+    for (size_t i = 0; i < fds.size(); ++i) {
+      if (fds[i] < 0) continue;
+      pollfd p;
+      p.fd = fds[i];
+      p.events = POLLIN;
+      polls.push_back(p);
+      ranks.push_back(i);
+    }
+    while (!polls.empty()) {
+      if (poll(&polls[0], polls.size(), -1) < 0) continue;
+      for (size_t i = 0; i < polls.size(); ++i) {
+        if (polls[i].revents == 0) continue;
+        Message message;
+        message.from = ranks[i];
+        string header(MESSAGE_HEADER_BYTES, 0);
+        bool ok = ReadAll(polls[i].fd, &header[0], header.size());
+        if (ok) {
+          PayloadReader in(header);
+          message.type = in.Get(4);
+          const unsigned long long size = in.Get(4);
+          ok = size <= (unsigned long long)MAX_MESSAGE_BYTES;
+          if (ok) message.data.resize(size);
+          ok = ok && (size == 0 ||
+                      ReadAll(polls[i].fd, &message.data[0], size));
+        }
+        if (!ok) {
+          // The peer is done, gone or broken, the search knows which.
+          message.type = MSG_CLOSED;
+          message.data.clear();
+          polls.erase(polls.begin() + i);
+          ranks.erase(ranks.begin() + i);
+          --i;
+        }
+        lock_guard<mutex> lock(mu);
+        messages.push_back(message);
+        cv.notify_all();
+      }
+    }
+  }
+
+  const vector<int> fds;
+  mutex mu;
+  condition_variable cv;
+  deque<Message> messages;
+  thread reader;
+
+  Inbox(const Inbox&);
+  void operator=(const Inbox&);
+};
+
+static bool SendMessage(int fd, int type, const string& data) {
+  string message;
+  PutInt(type, 4, &message);
+  PutInt(data.size(), 4, &message);
+  message += data;
+  return SendAll(fd, message.data(), message.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Search
+////////////////////////////////////////////////////////////////////////////////
+
+// One worker's part of the search, see distributed.h.
+template <class G, int WORDS>
+class Worker {
+ public:
+  typedef BasicState<G> State;
+  typedef StateKey<WORDS> Key;
+
+  Worker(const BasicBoard<G>& board, int rank, const vector<int>& fds)
+    : board(board), rank(rank), fds(fds), outboxes(fds.size()),
+      outbox_states(fds.size(), 0), groups(MAX_MOVES), lowest(MAX_MOVES),
+      send_failed(false) {}
+
+  bool Run(const State& start, DistributedResult* result, string* error);
+
+ private:
+  int Owner(const Key& key) const {
+    unsigned long long h = 0;
+    for (int i = 0; i < WORDS; ++i) {
+      h = (h ^ key.w[i]) * 0x9E3779B97F4A7C15ULL;
+      h ^= h >> 32;
+    }
+    return (h * 0x9E3779B97F4A7C15ULL >> 32) % fds.size();
+  }
+
+  // Appends state and its f to out: f, the number of tiles, the position and
+  // type of each, the number of moves and each move as its tile index plus
+  // its direction times 64, a byte each.
+  static void PutEntry(const State& state, int f, string* out);
+  // Reads back an entry of PutEntry(), false if it is broken.
+  static bool GetEntry(PayloadReader* in, State* state, int* f);
+
+  // The visited check of solve(), keeps state if it is new or improved.
+  void Visit(State* state, const Key& key, int f);
+  // Visits the states of a MSG_STATES payload, false if it is broken.
+  bool Receive(const string& data);
+  // Expands the lowest state, win gets a winning successor.
+  void Expand(State** win);
+  // Sends the outbox of peer, sets send_failed if it can't.
+  void Send(int peer);
+  int MinOpen() const;
+
+  const BasicBoard<G>& board;
+  const int rank;
+  // Connections by rank, -1 for this worker.
+  const vector<int> fds;
+  // Entries for each peer, and their number.
+  vector<string> outboxes;
+  vector<int> outbox_states;
+  VisitedTable<WORDS> visited;
+  vector<BasicStateGroup<G, WORDS> > groups;
+  // No state in groups has a lower f.
+  int lowest;
+  // A peer can't be sent to, the search is over.
+  bool send_failed;
+  DistributedResult stats;
+};
+
+template <class G, int WORDS>
+void Worker<G, WORDS>::PutEntry(const State& state, int f, string* out) {
+  PutInt(f, 1, out);
+  PutInt(state.NumTiles(), 1, out);
+  for (int i = 0; i < state.NumTiles(); ++i) {
+    PutInt(state.GetTile(i).pos, 1, out);
+    PutInt(state.GetTile(i).type, 1, out);
+  }
+  const typename State::HistoryItem* history = state.GetHistory();
+  PutInt(state.GetHistoryLen(), 1, out);
+  for (int i = 0; i < state.GetHistoryLen(); ++i) {
+    PutInt(history[i].tile_index + 64 * history[i].dir, 1, out);
+  }
+}
+
+template <class G, int WORDS>
+bool Worker<G, WORDS>::GetEntry(PayloadReader* in, State* state, int* f) {
+  *f = in->Get(1);
+  const int num_tiles = in->Get(1);
+  if (*f >= MAX_MOVES || num_tiles > G::MAX_TILES) return false;
+  Tile tiles[G::MAX_TILES];
+  for (int i = 0; i < num_tiles; ++i) {
+    const int pos = in->Get(1);
+    const int type = in->Get(1);
+    if (pos >= G::BOARD_SIZE || type >= NUM_TYPES) return false;
+    tiles[i].pos = pos;
+    tiles[i].type = type;
+  }
+  const int history_len = in->Get(1);
+  if (history_len > MAX_HISTORY) return false;
+  typename State::HistoryItem history[MAX_HISTORY];
+  for (int i = 0; i < history_len; ++i) {
+    const int move = in->Get(1);
+    if (move % 64 >= G::MAX_TILES) return false;
+    history[i].tile_index = move % 64;
+    history[i].dir = move / 64;
+  }
+  if (!in->Ok()) return false;
+  state->Set(tiles, num_tiles, history, history_len);
+  return true;
+}
+
+template <class G, int WORDS>
+void Worker<G, WORDS>::Visit(State* state, const Key& key, int f) {
+  int prev_f;
+  if (visited.Find(key, &prev_f)) {
+    if (prev_f <= f) {
+      delete state;
+      return;
+    }
+    groups[prev_f].RemoveState(key);
+  }
+  groups[f].AddState(key, state);
+  if (f < lowest) lowest = f;
+  visited.Insert(key, f);
+  ++stats.num_visited_states;
+}
+
+template <class G, int WORDS>
+bool Worker<G, WORDS>::Receive(const string& data) {
+  PayloadReader in(data);
+  while (!in.Done()) {
+    State* state = new State();
+    int f;
+    if (!GetEntry(&in, state, &f) || board.HashWords(*state) > WORDS) {
+      delete state;
+      return false;
+    }
+    Key key;
+    state->Hash(board, &key);
+    Visit(state, key, f);
+    ++stats.states_received;
+  }
+  return true;
+}
+
+template <class G, int WORDS>
+int Worker<G, WORDS>::MinOpen() const {
+  for (int f = lowest; f < MAX_MOVES; ++f) {
+    if (!groups[f].Empty()) return f;
+  }
+  return MAX_MOVES;
+}
+
+template <class G, int WORDS>
+void Worker<G, WORDS>::Send(int peer) {
+  if (outbox_states[peer] == 0 || send_failed) return;
+  if (!SendMessage(fds[peer], MSG_STATES, outboxes[peer])) {
+    send_failed = true;
+    return;
+  }
+  stats.states_sent += outbox_states[peer];
+  outboxes[peer].clear();
+  outbox_states[peer] = 0;
+}
+
+template <class G, int WORDS>
+void Worker<G, WORDS>::Expand(State** win) {
+  const State* curr = groups[lowest].Pop();
+  ++stats.num_expanded;
+  typename State::Cells occupied;
+  curr->GetOccupied(&occupied);
+  for (int tile_index = 0; tile_index < curr->NumTiles() && *win == NULL;
+       ++tile_index) {
+    const Tile& tile = curr->GetTile(tile_index);
+    if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+    for (int dir = 0; dir < 4; ++dir) {
+      State* next = new State();
+      const int res = curr->Move(board, tile_index, dir, occupied, next);
+      if (res == State::WIN) {
+        *win = next;
+        break;
+      }
+      if (res == State::LOSE || board.IsDead(*next)) {
+        delete next;
+        continue;
+      }
+      Key key;
+      next->Hash(board, &key);
+      const int f = curr->GetHistoryLen() + 1 + board.MinMovesFrom(*next);
+      if (f >= MAX_MOVES) {
+        delete next;
+        continue;
+      }
+      const int owner = Owner(key);
+      if (owner == rank) {
+        Visit(next, key, f);
+        continue;
+      }
+      PutEntry(*next, f, &outboxes[owner]);
+      delete next;
+      if (++outbox_states[owner] >= BATCH_STATES) Send(owner);
+    }
+  }
+  delete curr;
+}
+
+template <class G, int WORDS>
+bool Worker<G, WORDS>::Run(const State& start, DistributedResult* result,
+                           string* error) {
+  const int num_workers = fds.size();
+  Key start_key;
+  start.Hash(board, &start_key);
+  int bound = board.MinMovesFrom(start);
+  if (Owner(start_key) == rank && bound < MAX_MOVES) {
+    Visit(new State(start), start_key, bound);
+  }
+  Inbox inbox(fds);
+  // Messages for the end of the round, or of peers ahead by a round.
+  deque<Message> later;
+  bool ok = true;
+  while (bound < MAX_MOVES) {
+    stats.lower_bound = bound;
+    ++stats.num_rounds;
+    const long long expanded_before = stats.num_expanded;
+    State* win = NULL;
+    while (win == NULL && !send_failed && ok &&
+           (lowest = MinOpen()) <= bound) {
+      Expand(&win);
+      // The states of the peers go through the visited check as they come,
+      // rather than piling up in the inbox until the round ends. Whatever
+      // else they send waits for the end of the round.
+      Message message;
+      while (ok && inbox.TryPop(&message)) {
+        if (message.type != MSG_STATES) {
+          later.push_back(message);
+        } else if (!Receive(message.data)) {
+          *error = "Bad message from a worker";
+          ok = false;
+        }
+      }
+    }
+    RoundSummary summary;
+    summary.expanded = stats.num_expanded - expanded_before;
+    summary.win_length = win != NULL ? win->GetHistoryLen() : MAX_MOVES;
+    summary.min_open = MinOpen();
+    for (int peer = 0; peer < num_workers; ++peer) {
+      if (peer == rank) continue;
+      Send(peer);
+      if (!send_failed &&
+          !SendMessage(fds[peer], MSG_END_ROUND, EncodeSummary(summary))) {
+        send_failed = true;
+      }
+    }
+    if (send_failed) {
+      *error = "Can't send to a worker";
+      ok = false;
+    }
+    // The totals of the round, and the lowest rank with the shortest win.
+    long long expanded = summary.expanded;
+    int win_length = summary.win_length;
+    int winner = rank;
+    int min_open = summary.min_open;
+    // A peer that has ended the round may already be in the next one. Its
+    // states can be handled now, the rest waits for the next round.
+    vector<bool> ended(num_workers, false);
+    deque<Message> next_round;
+    for (int ends = 1; ends < num_workers && ok;) {
+      Message message;
+      if (!later.empty()) {
+        message = later.front();
+        later.pop_front();
+      } else {
+        inbox.Pop(&message);
+      }
+      if (message.type != MSG_STATES && ended[message.from]) {
+        next_round.push_back(message);
+      } else if (message.type == MSG_CLOSED) {
+        *error = "A worker went away";
+        ok = false;
+      } else if (message.type == MSG_STATES) {
+        if (!Receive(message.data)) {
+          *error = "Bad message from a worker";
+          ok = false;
+        }
+      } else {
+        RoundSummary other;
+        if (message.type != MSG_END_ROUND ||
+            !DecodeSummary(message.data, &other)) {
+          *error = "Bad message from a worker";
+          ok = false;
+          break;
+        }
+        expanded += other.expanded;
+        if (other.win_length < win_length ||
+            (other.win_length == win_length && message.from < winner)) {
+          win_length = other.win_length;
+          winner = message.from;
+        }
+        if (other.min_open < min_open) min_open = other.min_open;
+        ended[message.from] = true;
+        ++ends;
+      }
+    }
+    if (ok && win_length < MAX_MOVES) {
+      stats.status = SOLVED;
+      stats.length = win_length;
+      stats.lower_bound = win_length;
+      if (winner == rank) {
+        stats.solution = ReplaySolution(board, start, win->GetHistory(),
+                                        win->GetHistoryLen());
+      }
+    }
+    delete win;
+    later.insert(later.end(), next_round.begin(), next_round.end());
+    if (!ok || stats.status == SOLVED) break;
+    // States that arrived in the round may be within the bound.
+    if (expanded == 0) bound = min_open;
+  }
+  if (ok && stats.status != SOLVED) stats.lower_bound = MAX_MOVES;
+  // Ends the reads of the peers. A worker that fails stops reading too, so
+  // the Inbox is done and the peers see it go away and fail in turn.
+  for (int peer = 0; peer < num_workers; ++peer) {
+    if (peer != rank) shutdown(fds[peer], ok ? SHUT_WR : SHUT_RDWR);
+  }
+  stats.visited_bytes = visited.Bytes();
+  *result = stats;
+  return ok;
+}
+
+template <class G, int WORDS>
+static bool RunWorker(const BasicBoard<G>& board, const BasicState<G>& start,
+                      int rank, const vector<int>& fds,
+                      DistributedResult* result, string* error) {
+  Worker<G, WORDS> worker(board, rank, fds);
+  return worker.Run(start, result, error);
+}
+
+template <class G>
+static bool SolveOnGeometry(const Level& level, int rank,
+                            const vector<int>& fds, DistributedResult* result,
+                            string* error) {
+  char bc[G::BOARD_SIZE + 1];
+  if (LevelToBoard<G>(level, bc) > G::MAX_TILES) {
+    *error = "Too many tiles";
+    return false;
+  }
+  bc[G::BOARD_SIZE] = 0;
+  BasicBoard<G> board(bc, REAL_RULES);
+  BasicState<G> start(bc);
+  const int words = board.KeyWords(start);
+  if (words <= 1) return RunWorker<G, 1>(board, start, rank, fds, result,
+                                         error);
+  if (words <= 2) return RunWorker<G, 2>(board, start, rank, fds, result,
+                                         error);
+  if (words <= 3) return RunWorker<G, 3>(board, start, rank, fds, result,
+                                         error);
+  if (words <= MAX_KEY_WORDS) {
+    return RunWorker<G, MAX_KEY_WORDS>(board, start, rank, fds, result,
+                                       error);
+  }
+  *error = "Too many tiles to hash";
+  return false;
+}
+
+// SolveOnGeometry() on the smallest geometry level fits into.
+static bool SolveLevel(const Level& level, int rank, const vector<int>& fds,
+                       DistributedResult* result, string* error) {
+  const int height = level.size();
+  const int width = level.empty() ? 0 : level[0].size();
+#define TRY_GEOMETRY(G)                                                 \
+  if (width + 2 <= G::BOARD_X && height + 2 <= G::BOARD_Y) {            \
+    return SolveOnGeometry<G>(level, rank, fds, result, error);         \
+  }
+  GTN_FOR_EACH_GEOMETRY(TRY_GEOMETRY)
+#undef TRY_GEOMETRY
+  *error = "Level too big";
+  return false;
+}
+
+bool DistributedSolve(const Level& level, int rank,
+                      const vector<string>& peers, int listen_fd,
+                      DistributedResult* result, string* error) {
+  const int num_workers = peers.size();
+  vector<int> fds(num_workers, -1);
+  const long long deadline = NowMicros() + CONNECT_TIMEOUT_US;
+  const unsigned long long level_hash = LevelHash(level);
+  string handshake;
+  PutInt(PROTOCOL_VERSION, 4, &handshake);
+  PutInt(rank, 4, &handshake);
+  PutInt(level_hash, 8, &handshake);
+  bool ok = true;
+  for (int peer = 0; peer < rank && ok; ++peer) {
+    fds[peer] = ConnectTcp(peers[peer], deadline);
+    ok = fds[peer] >= 0 &&
+         SendAll(fds[peer], handshake.data(), handshake.size());
+    if (!ok) *error = "Can't connect to " + peers[peer];
+  }
+  for (int n = rank + 1; n < num_workers && ok; ++n) {
+    const int fd = AcceptTcp(listen_fd, deadline);
+    string other(HANDSHAKE_BYTES, 0);
+    ok = fd >= 0 && ReadAll(fd, &other[0], other.size());
+    PayloadReader in(other);
+    const int version = in.Get(4);
+    const int peer = in.Get(4);
+    ok = ok && version == PROTOCOL_VERSION && in.Get(8) == level_hash &&
+         peer > rank && peer < num_workers && fds[peer] < 0;
+    if (ok) {
+      fds[peer] = fd;
+    } else {
+      if (fd >= 0) close(fd);
+      *error = "Bad connection from a peer";
+    }
+  }
+  for (int peer = 0; peer < num_workers && ok; ++peer) {
+    const int one = 1;
+    if (fds[peer] >= 0) {
+      setsockopt(fds[peer], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+  }
+  if (ok) ok = SolveLevel(level, rank, fds, result, error);
+  for (int peer = 0; peer < num_workers; ++peer) {
+    if (fds[peer] >= 0) close(fds[peer]);
+  }
+  return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Local workers
+////////////////////////////////////////////////////////////////////////////////
+
+// A result as one line, the solution last.
+static string FormatResult(const DistributedResult& r) {
+  stringstream ss;
+  ss << r.status << " " << r.length << " " << r.lower_bound << " "
+     << r.num_expanded << " " << r.num_visited_states << " " << r.states_sent
+     << " " << r.states_received << " " << r.visited_bytes << " "
+     << r.num_rounds << " " << r.solution;
+  return ss.str();
+}
+
+static bool ParseResult(const string& line, DistributedResult* r) {
+  stringstream ss(line);
+  int status;
+  if (!(ss >> status >> r->length >> r->lower_bound >> r->num_expanded >>
+        r->num_visited_states >> r->states_sent >> r->states_received >>
+        r->visited_bytes >> r->num_rounds)) {
+    return false;
+  }
+  r->status = SolveStatus(status);
+  ss >> r->solution;
+  return true;
+}
+
+bool RunLocalWorkers(const Level& level, int num_workers,
+                     vector<DistributedResult>* results, string* error) {
+  vector<int> listen_fds;
+  vector<string> peers;
+  for (int i = 0; i < num_workers; ++i) {
+    int port;
+    const int fd = ListenTcp("127.0.0.1:0", &port);
+    if (fd < 0) {
+      *error = "Can't listen on the loopback interface";
+      for (size_t j = 0; j < listen_fds.size(); ++j) close(listen_fds[j]);
+      return false;
+    }
+    listen_fds.push_back(fd);
+    stringstream ss;
+    ss << "127.0.0.1:" << port;
+    peers.push_back(ss.str());
+  }
+  vector<pid_t> pids;
+  vector<int> pipes;
+  for (int rank = 0; rank < num_workers; ++rank) {
+    int fds[2];
+    if (pipe(fds) != 0) break;
+    const pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      for (int i = 0; i < num_workers; ++i) {
+        if (i != rank) close(listen_fds[i]);
+      }
+      DistributedResult result;
+      string worker_error;
+      const bool ok = DistributedSolve(level, rank, peers, listen_fds[rank],
+                                       &result, &worker_error);
+      const string line =
+          (ok ? "ok " + FormatResult(result) : "error " + worker_error) + "\n";
+      _exit(WriteAll(fds[1], line.data(), line.size()) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+      close(fds[0]);
+      break;
+    }
+    pids.push_back(pid);
+    pipes.push_back(fds[0]);
+  }
+  for (int i = 0; i < num_workers; ++i) close(listen_fds[i]);
+  bool ok = (int)pids.size() == num_workers;
+  if (!ok) *error = "Can't start the workers";
+  results->assign(pids.size(), DistributedResult());
+  for (size_t rank = 0; rank < pids.size(); ++rank) {
+    string line;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(pipes[rank], chunk, sizeof(chunk))) > 0) {
+      line.append(chunk, n);
+    }
+    close(pipes[rank]);
+    int status;
+    waitpid(pids[rank], &status, 0);
+    if (line.compare(0, 3, "ok ") == 0 &&
+        ParseResult(line.substr(3), &(*results)[rank])) {
+      continue;
+    }
+    if (ok) {
+      *error = line.compare(0, 6, "error ") == 0
+                   ? line.substr(6, line.size() - 7)
+                   : "A worker died";
+    }
+    ok = false;
+  }
+  return ok;
+}
@@ -0,0 +1,69 @@
+#ifndef _GTN_DISTRIBUTED_H__
+#define _GTN_DISTRIBUTED_H__
+
+#include <string>
+#include <vector>
+
+#include "level.h"
+#include "solve.h"
+
+// Search of one level by several worker processes, for levels whose states
+// don't fit in the memory of one. Every state is owned by one worker, picked
+// by the hash of its key, which keeps it in its visited table and its open
+// list. A worker expands its own states and sends the successors that belong
+// to others over TCP, in batches.
+//
+// The search runs in rounds. In a round every worker expands its states with
+// f up to the bound, then sends each peer an end of round message with what
+// it did, and handles the states it receives until it has the end of round
+// message of every peer. Connections deliver in order, so by then every state
+// sent in the round has arrived, and every worker knows the same totals: a
+// win ends the search, a round that expanded nothing raises the bound to the
+// lowest f left anywhere, otherwise the next round expands the states that
+// arrived.
+//
+// Messages are little endian integers of a fixed size, states are sent as
+// their tiles and moves, so workers may run on hosts of any byte order. The
+// workers of a search must run the same protocol version on the same level,
+// which the handshake checks.
+
+struct DistributedResult {
+  DistributedResult();
+  // SOLVED or NO_SOLUTION, the same on every worker.
+  SolveStatus status;
+  // Moves of the shortest win found in the last round, -1 without one.
+  int length;
+  int lower_bound;
+  // ReplaySolution() of the win, only on the worker that found it.
+  std::string solution;
+  // This worker's share.
+  long long num_expanded;
+  long long num_visited_states;
+  long long states_sent;
+  long long states_received;
+  // Memory of this worker's visited states.
+  long long visited_bytes;
+  int num_rounds;
+};
+
+// Listens on "host:port", port 0 picks a free one which port, if not NULL,
+// gets. Returns the socket, -1 if it can't be set up.
+int ListenTcp(const std::string& address, int* port);
+
+// Runs worker rank of peers.size() on level. peers[i] is the "host:port"
+// worker i listens on, listen_fd is the socket of peers[rank] from
+// ListenTcp(). Workers connect to the lower ranks and accept the higher ones,
+// waiting 10 seconds for them to come up. Returns false with error set if the
+// level can't be solved or a peer goes away.
+bool DistributedSolve(const Level& level, int rank,
+                      const std::vector<std::string>& peers, int listen_fd,
+                      DistributedResult* result, std::string* error);
+
+// Solves level with num_workers child processes on the loopback interface.
+// results gets the result of each worker by rank. Returns false with error
+// set if a worker fails.
+bool RunLocalWorkers(const Level& level, int num_workers,
+                     std::vector<DistributedResult>* results,
+                     std::string* error);
+
+#endif // _GTN_DISTRIBUTED_H__
@@ -0,0 +1,109 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "distributed.h"
+#include "level.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+static Level ReadLevel(const string& path) {
+  Level level;
+  string error;
+  EXPECT_TRUE(ReadLevelFile(path, &level, &error)) << error;
+  return level;
+}
+
+// Every worker agrees on the outcome, one of them has the solution.
+static void CheckAgree(const vector<DistributedResult>& results, int length) {
+  int num_solutions = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_EQ(SOLVED, results[i].status);
+    EXPECT_EQ(length, results[i].length);
+    EXPECT_EQ(results[0].num_rounds, results[i].num_rounds);
+    if (!results[i].solution.empty()) ++num_solutions;
+  }
+  EXPECT_EQ(1, num_solutions);
+}
+
+TEST(TestDistributed, OneWorker) {
+  vector<DistributedResult> results;
+  string error;
+  ASSERT_TRUE(RunLocalWorkers(ReadLevel("levels/P1L01"), 1, &results, &error))
+      << error;
+  ASSERT_EQ(1, results.size());
+  CheckAgree(results, 4);
+  EXPECT_EQ(0, results[0].states_sent);
+  EXPECT_EQ("(3,4)-MSE-U/(1,4)-MSE-L/(6,4)-SQR-U/(1,4)-SQR-R/",
+            results[0].solution);
+}
+
+TEST(TestDistributed, Partitions) {
+  const Level level = ReadLevel("levels/P4L30");
+  vector<DistributedResult> single;
+  string error;
+  ASSERT_TRUE(RunLocalWorkers(level, 1, &single, &error)) << error;
+  CheckAgree(single, 26);
+  vector<DistributedResult> results;
+  ASSERT_TRUE(RunLocalWorkers(level, 3, &results, &error)) << error;
+  ASSERT_EQ(3, results.size());
+  CheckAgree(results, 26);
+  long long sent = 0;
+  long long received = 0;
+  for (size_t i = 0; i < results.size(); ++i) {
+    // Each worker keeps a share of the states.
+    EXPECT_LT(0, results[i].num_visited_states);
+    EXPECT_GT(single[0].num_visited_states * 2 / 3,
+              results[i].num_visited_states);
+    EXPECT_LT(0, results[i].num_expanded);
+    sent += results[i].states_sent;
+    received += results[i].states_received;
+  }
+  EXPECT_LT(0, sent);
+  EXPECT_EQ(sent, received);
+}
+
+// Rank 0 resets the connection after the handshake, rank 1 fails on its next
+// send instead of waiting or dying on SIGPIPE.
+TEST(TestDistributed, PeerGoesAway) {
+  int port0, port1;
+  const int listen0 = ListenTcp("127.0.0.1:0", &port0);
+  const int listen1 = ListenTcp("127.0.0.1:0", &port1);
+  ASSERT_LE(0, listen0);
+  ASSERT_LE(0, listen1);
+  thread peer([listen0]() {
+    const int fd = accept(listen0, NULL, NULL);
+    char handshake[64];
+    if (read(fd, handshake, sizeof(handshake)) <= 0) ADD_FAILURE();
+    linger reset;
+    reset.l_onoff = 1;
+    reset.l_linger = 0;
+    setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+    if (fd >= 0) close(fd);
+  });
+  vector<string> peers;
+  peers.push_back("127.0.0.1:" + to_string(port0));
+  peers.push_back("127.0.0.1:" + to_string(port1));
+  DistributedResult result;
+  string error;
+  EXPECT_FALSE(DistributedSolve(ReadLevel("levels/P4L30"), 1, peers, listen1,
+                                &result, &error));
+  EXPECT_TRUE(error == "A worker went away" ||
+              error == "Can't send to a worker") << error;
+  peer.join();
+  close(listen0);
+  close(listen1);
+}
+
+TEST(TestDistributed, BadLevel) {
+  // Bigger than any geometry.
+  const Level level(20, vector<string>(20, "------"));
+  vector<DistributedResult> results;
+  string error;
+  EXPECT_FALSE(RunLocalWorkers(level, 2, &results, &error));
+  EXPECT_EQ("Level too big", error);
+}
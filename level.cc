@@ -0,0 +1,69 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "convert.h"
+#include "level.h"
+#include "utils.h"
+
+using namespace std;
+
+bool AddLevelRow(const string& row, Level* level, string* error) {
+  vector<string> values;
+  SplitString(row, ",", &values);
+  if (!level->empty() && values.size() != (*level)[0].size()) {
+    *error = "Broken line in csv: " + row;
+    return false;
+  }
+  for (size_t x = 0; x < values.size(); ++x) {
+    if (values[x].find("TRE") == string::npos &&
+        TriToCode(values[x].substr(0, 3).c_str()) == '?') {
+      *error = "Unknown cell: " + values[x];
+      return false;
+    }
+  }
+  level->push_back(values);
+  return true;
+}
+
+bool ReadLevelFile(const string& path, Level* level, string* error) {
+  ifstream in(path.c_str());
+  if (!in) {
+    *error = "Can't read " + path;
+    return false;
+  }
+  string row;
+  while (in >> row) {
+    if (!AddLevelRow(row, level, error)) return false;
+  }
+  if (level->empty()) {
+    *error = "Empty level";
+    return false;
+  }
+  return true;
+}
+
+template <class G>
+int LevelToBoard(const Level& level, char* bc) {
+  int num_tiles = 0;
+  for (int i = 0; i < G::BOARD_SIZE; ++i) bc[i] = '#';
+  for (size_t y = 0; y < level.size(); ++y) {
+    const vector<string>& values = level[y];
+    for (size_t x = 0; x < values.size(); ++x) {
+      char& c = bc[(y+1)*G::BOARD_X+(x+1)];
+      if (values[x].find("TRE") != string::npos) {
+        c = '#';
+      } else {
+        c = TriToCode(values[x].substr(0, 3).c_str());
+        if (c != TriToCode("---")) ++num_tiles;
+      }
+    }
+  }
+  return num_tiles;
+}
+
+#define INSTANTIATE(G) \
+  template int LevelToBoard<G>(const Level&, char*);
+GTN_FOR_EACH_GEOMETRY(INSTANTIATE)
+#undef INSTANTIATE
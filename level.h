@@ -0,0 +1,25 @@
+#ifndef _GTN_LEVEL_H__
+#define _GTN_LEVEL_H__
+
+#include <string>
+#include <vector>
+
+// A level as in the levels/ files: rows of comma separated cells like
+// "SQR_A1", "------" for an empty cell or "TRE_A1" for a wall.
+typedef std::vector<std::vector<std::string> > Level;
+
+// Appends a csv row. Returns false with error set if it doesn't have as many
+// cells as the earlier rows or has a cell of unknown type.
+bool AddLevelRow(const std::string& row, Level* level, std::string* error);
+
+// Reads a levels/ file, one row per line. Returns false with error set if it
+// can't be read or is not a level.
+bool ReadLevelFile(const std::string& path, Level* level, std::string* error);
+
+// Writes the BOARD_SIZE cells of G for level into bc: the level in the top left
+// corner, one cell off the edges, and walls everywhere else. Returns the number
+// of tiles.
+template <class G>
+int LevelToBoard(const Level& level, char* bc);
+
+#endif // _GTN_LEVEL_H__
@@ -0,0 +1,403 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "concurrent_visited.h"
+#include "level.h"
+#include "microbench.h"
+#include "rules.h"
+#include "solve.h"
+#include "utils.h"
+#include "visited.h"
+
+using namespace std;
+
+static const Rules REAL_RULES = Rules("rules-real.csv");
+
+// Cold states take this much memory, well over any last level cache.
+static const long long COLD_BYTES = 64LL << 20;
+// Warm states.
+static const int NUM_WARM = 16;
+
+// Exposes the kernels that are only visible for testing.
+class BenchState : public State {
+ public:
+  BenchState() {}
+  explicit BenchState(const State& s) : State(s) {}
+  using State::Find;
+  using State::FindMany;
+  using State::Sort;
+};
+
+// Board of the level file at path on the standard geometry, NULL if it
+// doesn't fit. bc gets the cells.
+static Board* LoadBoard(const string& path, char bc[BOARD_SIZE + 1]) {
+  Level level;
+  string error;
+  if (!ReadLevelFile(path, &level, &error)) return NULL;
+  if ((int)level.size() + 2 > BOARD_Y || (int)level[0].size() + 2 > BOARD_X) {
+    return NULL;
+  }
+  if (LevelToBoard<StandardGeometry>(level, bc) > MAX_TILES) return NULL;
+  bc[BOARD_SIZE] = 0;
+  Board* board = new Board(bc, REAL_RULES);
+  if (board->KeyWords(State(bc)) > MAX_KEY_WORDS) {
+    delete board;
+    return NULL;
+  }
+  return board;
+}
+
+int RecordTrace(const vector<string>& levels, int samples_per_level,
+                vector<TraceSample>* trace) {
+  int num_traced = 0;
+  for (size_t l = 0; l < levels.size(); ++l) {
+    char bc[BOARD_SIZE + 1];
+    Board* board = LoadBoard(levels[l], bc);
+    if (board == NULL) continue;
+    const State start(bc);
+    vector<vector<pair<int, int> > > expanded;
+    SolveOptions options;
+    options.on_expand = [&expanded](const vector<pair<int, int> >& moves) {
+      expanded.push_back(moves);
+    };
+    solve(*board, start, options);
+    const int n = expanded.size();
+    const int k = min(n, samples_per_level);
+    for (int i = 0; i < k; ++i) {
+      const vector<pair<int, int> >& moves = expanded[(long long)i * n / k];
+      TraceSample sample;
+      sample.level = levels[l];
+      State curr = start;
+      for (size_t m = 0; m < moves.size(); ++m) {
+        sample.moves.push_back(
+            make_pair(curr.GetTile(moves[m].first).pos, moves[m].second));
+        State next;
+        curr.Move(*board, moves[m].first, moves[m].second, &next);
+        curr = next;
+      }
+      trace->push_back(sample);
+    }
+    delete board;
+    ++num_traced;
+  }
+  return num_traced;
+}
+
+bool WriteTrace(const string& path, const vector<TraceSample>& trace) {
+  ofstream out(path.c_str());
+  if (!out) return false;
+  for (size_t i = 0; i < trace.size(); ++i) {
+    out << trace[i].level;
+    for (size_t m = 0; m < trace[i].moves.size(); ++m) {
+      out << " " << trace[i].moves[m].first << ":" << trace[i].moves[m].second;
+    }
+    out << "\n";
+  }
+  return (bool)out;
+}
+
+bool ReadTrace(const string& path, vector<TraceSample>* trace) {
+  ifstream in(path.c_str());
+  if (!in) return false;
+  string line;
+  while (getline(in, line)) {
+    stringstream ss(line);
+    TraceSample sample;
+    if (!(ss >> sample.level)) continue;
+    string move;
+    while (ss >> move) {
+      const size_t colon = move.find(':');
+      if (colon == string::npos) return false;
+      sample.moves.push_back(make_pair(atoi(move.substr(0, colon).c_str()),
+                                       atoi(move.substr(colon + 1).c_str())));
+    }
+    trace->push_back(sample);
+  }
+  return true;
+}
+
+// The states of a microbenchmark and the boards they are on.
+struct WorkingSet {
+  vector<const Board*> boards;
+  vector<BenchState> states;
+  // Order of the states in the runs.
+  vector<int> order;
+};
+
+// Times kernel(board, state) over set until it counted ops, best of reps.
+// kernel returns the ops it did and adds to sink.
+template <class Kernel>
+static double TimeKernel(const WorkingSet& set, long long ops, int reps,
+                         Kernel kernel) {
+  double best = 0;
+  unsigned long long sink = 0;
+  for (int r = 0; r < reps; ++r) {
+    long long done = 0;
+    size_t i = 0;
+    const long long start = NowMicros();
+    while (done < ops) {
+      const int s = set.order[i];
+      done += kernel(*set.boards[s], set.states[s], &sink);
+      if (++i == set.order.size()) i = 0;
+    }
+    const double ns = (NowMicros() - start) * 1000.0 / done;
+    if (r == 0 || ns < best) best = ns;
+  }
+  // Keep the kernels from being optimized away.
+  if (sink == 42) best += 1e-9;
+  return best;
+}
+
+static int MoveKernel(const Board& board, const BenchState& state,
+                      unsigned long long* sink) {
+  int ops = 0;
+  State next;
+  for (int t = 0; t < state.NumTiles(); ++t) {
+    const Tile& tile = state.GetTile(t);
+    if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+    for (int dir = 0; dir < 4; ++dir) {
+      *sink += state.Move(board, t, dir, &next);
+      ++ops;
+    }
+  }
+  return ops;
+}
+
+// MoveKernel() with the occupied cells, as the solver expands a state.
+static int MoveOccupiedKernel(const Board& board, const BenchState& state,
+                              unsigned long long* sink) {
+  int ops = 0;
+  State next;
+  State::Cells occupied;
+  state.GetOccupied(&occupied);
+  for (int t = 0; t < state.NumTiles(); ++t) {
+    const Tile& tile = state.GetTile(t);
+    if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+    for (int dir = 0; dir < 4; ++dir) {
+      *sink += state.Move(board, t, dir, occupied, &next);
+      ++ops;
+    }
+  }
+  return ops;
+}
+
+static int HashKernel(const Board& board, const BenchState& state,
+                      unsigned long long* sink) {
+  StateKey<MAX_KEY_WORDS> key;
+  state.Hash(board, &key);
+  *sink += key.w[0];
+  return 1;
+}
+
+// The lookups Move() does around the squirrel.
+static int FindKernel(const Board& /*board*/, const BenchState& state,
+                      unsigned long long* sink) {
+  const int pos = state.GetSquirrelPos();
+  for (int dir = 0; dir < 4; ++dir) {
+    *sink += state.Find(pos + State::DIRECTIONS[dir]);
+  }
+  return 4;
+}
+
+// The lookups of one slide step in Move(), as one FindMany().
+static int FindManyKernel(const Board& /*board*/, const BenchState& state,
+                          unsigned long long* sink) {
+  const int pos = state.GetSquirrelPos();
+  const int around[3] = { pos + State::DIRECTIONS[State::UP],
+                          pos + State::DIRECTIONS[State::LEFT],
+                          pos + State::DIRECTIONS[State::RIGHT] };
+  int found[3];
+  state.FindMany(around, 3, found);
+  *sink += found[0] + found[1] + found[2];
+  return 1;
+}
+
+// Sorts a copy of the sorted tiles, as after a Move() that kept their order.
+static int SortKernel(const Board& /*board*/, const BenchState& state,
+                      unsigned long long* sink) {
+  BenchState copy = state;
+  copy.Sort();
+  *sink += copy.GetTile(0).pos;
+  return 1;
+}
+
+static int GetActionKernel(const Board& /*board*/, const BenchState& state,
+                           unsigned long long* sink) {
+  int ops = 0;
+  for (int m = 0; m < state.NumTiles(); ++m) {
+    const int moving = state.GetTile(m).type;
+    if (!MOVEABLE[moving]) continue;
+    for (int s = 0; s < state.NumTiles(); ++s) {
+      for (int relation = 0; relation < Rules::NUM_RELATIONS; ++relation) {
+        *sink += REAL_RULES.GetAction(moving, state.GetTile(s).type, relation)
+                     .exists;
+        ++ops;
+      }
+    }
+  }
+  return ops;
+}
+
+bool RunMicrobench(const vector<TraceSample>& trace, long long ops_per_kernel,
+                   int reps, vector<MicrobenchResult>* results,
+                   string* error) {
+  // Replay the samples.
+  map<string, Board*> boards;
+  map<string, State> starts;
+  WorkingSet all;
+  bool ok = true;
+  for (size_t i = 0; i < trace.size() && ok; ++i) {
+    const TraceSample& sample = trace[i];
+    if (boards.find(sample.level) == boards.end()) {
+      char bc[BOARD_SIZE + 1];
+      boards[sample.level] = LoadBoard(sample.level, bc);
+      if (boards[sample.level] != NULL) starts[sample.level] = State(bc);
+    }
+    const Board* board = boards[sample.level];
+    if (board == NULL) {
+      *error = "Can't load " + sample.level;
+      ok = false;
+      break;
+    }
+    State curr = starts[sample.level];
+    for (size_t m = 0; m < sample.moves.size(); ++m) {
+      int tile_index = -1;
+      for (int t = 0; t < curr.NumTiles(); ++t) {
+        if (curr.GetTile(t).pos == sample.moves[m].first &&
+            MOVEABLE[curr.GetTile(t).type]) {
+          tile_index = t;
+        }
+      }
+      State next;
+      if (tile_index < 0 ||
+          curr.Move(*board, tile_index, sample.moves[m].second, &next) != 0) {
+        stringstream ss;
+        ss << "Sample " << i << " of " << sample.level << " doesn't replay";
+        *error = ss.str();
+        ok = false;
+        break;
+      }
+      curr = next;
+    }
+    curr.ClearHistory();
+    all.boards.push_back(board);
+    all.states.push_back(BenchState(curr));
+  }
+  if (ok && all.states.empty()) {
+    *error = "Empty trace";
+    ok = false;
+  }
+  if (ok) {
+    WorkingSet warm;
+    for (int i = 0; i < NUM_WARM && i < (int)all.states.size(); ++i) {
+      warm.boards.push_back(all.boards[i]);
+      warm.states.push_back(all.states[i]);
+      warm.order.push_back(i);
+    }
+    WorkingSet cold;
+    const long long num_cold = max((long long)all.states.size(),
+                                   COLD_BYTES / (long long)sizeof(State));
+    for (long long i = 0; i < num_cold; ++i) {
+      cold.boards.push_back(all.boards[i % all.states.size()]);
+      cold.states.push_back(all.states[i % all.states.size()]);
+      cold.order.push_back(i);
+    }
+    // Fixed seed, the same order in every run.
+    srand(1);
+    random_shuffle(cold.order.begin(), cold.order.end());
+
+    const WorkingSet* sets[] = { &warm, &cold };
+    const char* set_names[] = { "warm", "cold" };
+    const char* kernel_names[] = { "move", "move_occupied", "hash", "find",
+                                   "find_many", "sort", "get_action" };
+    int (*kernels[])(const Board&, const BenchState&, unsigned long long*) = {
+      MoveKernel, MoveOccupiedKernel, HashKernel, FindKernel, FindManyKernel,
+      SortKernel, GetActionKernel
+    };
+    // Kernels that depend on the Find() implementation.
+    const bool uses_find[] = { true, true, false, true, true, false, false };
+    const FindImpl orig_impl = GetFindImpl();
+    for (int k = 0; k < 7; ++k) {
+      for (int impl = 0; impl < NUM_FIND_IMPLS; ++impl) {
+        if (uses_find[k] ? !SetFindImpl(FindImpl(impl)) : impl > 0) continue;
+        for (int s = 0; s < 2; ++s) {
+          MicrobenchResult result;
+          result.kernel = kernel_names[k];
+          if (uses_find[k]) {
+            result.kernel += string("/") + FindImplName(FindImpl(impl));
+          }
+          result.variant = set_names[s];
+          result.ops = ops_per_kernel;
+          result.ns_per_op = TimeKernel(*sets[s], ops_per_kernel, reps,
+                                        kernels[k]);
+          results->push_back(result);
+        }
+      }
+    }
+    SetFindImpl(orig_impl);
+  }
+  for (map<string, Board*>::iterator it = boards.begin(); it != boards.end();
+       ++it) {
+    delete it->second;
+  }
+  return ok;
+}
+
+// Key number i of the scaling runs, spread over the bits like State::Hash().
+static StateKey<2> ScalingKey(unsigned long long i) {
+  StateKey<2> key;
+  key.w[0] = i * 0x9E3779B97F4A7C15ULL;
+  key.w[1] = (i * 0xC2B2AE3D27D4EB4FULL) ^ 1;
+  return key;
+}
+
+void RunVisitedScaling(int max_threads, long long ops_per_thread,
+                       vector<MicrobenchResult>* results) {
+  {
+    const long long num_keys = max(1LL, ops_per_thread / 8);
+    VisitedTable<2> table;
+    const long long start = NowMicros();
+    for (long long i = 0; i < ops_per_thread; ++i) {
+      const StateKey<2> key = ScalingKey(i * 7919 % num_keys);
+      int g;
+      if (!table.Find(key, &g)) table.Insert(key, i % 16);
+    }
+    MicrobenchResult result;
+    result.kernel = "visited";
+    result.variant = "threads=1";
+    result.ops = ops_per_thread;
+    result.ns_per_op = (NowMicros() - start) * 1000.0 / ops_per_thread;
+    results->push_back(result);
+  }
+  for (int n = 1; n <= max_threads; n *= 2) {
+    const long long total_ops = ops_per_thread * n;
+    const long long num_keys = max(1LL, total_ops / 8);
+    ConcurrentVisitedTable table(num_keys);
+    vector<thread> threads;
+    const long long start = NowMicros();
+    for (int t = 0; t < n; ++t) {
+      threads.push_back(thread([&table, t, n, num_keys, ops_per_thread]() {
+        for (long long i = t; i < ops_per_thread * n; i += n) {
+          table.InsertOrImprove(ScalingKey(i * 7919 % num_keys), i % 16,
+                                NULL);
+        }
+      }));
+    }
+    for (int t = 0; t < n; ++t) threads[t].join();
+    MicrobenchResult result;
+    result.kernel = "concurrent_visited";
+    stringstream ss;
+    ss << "threads=" << n;
+    result.variant = ss.str();
+    result.ops = total_ops;
+    result.ns_per_op = (NowMicros() - start) * 1000.0 / total_ops;
+    results->push_back(result);
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef _GTN_MICROBENCH_H__
+#define _GTN_MICROBENCH_H__
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// A state expanded by a solve: the level file and the moves from its start,
+// each the position of the moving tile and the direction. Positions rather
+// than tile indices keep traces valid when the tile order changes.
+struct TraceSample {
+  std::string level;
+  std::vector<std::pair<int, int> > moves;
+};
+
+// Solves each level on the standard board and keeps samples_per_level of its
+// expanded states, spread evenly over the search. Returns the number of
+// levels traced, others are skipped.
+int RecordTrace(const std::vector<std::string>& levels, int samples_per_level,
+                std::vector<TraceSample>* trace);
+
+// One sample per line: the level and pos:dir moves, separated by spaces.
+bool WriteTrace(const std::string& path, const std::vector<TraceSample>& trace);
+bool ReadTrace(const std::string& path, std::vector<TraceSample>* trace);
+
+struct MicrobenchResult {
+  // "move", "move_occupied", "hash", "find", "find_many", "sort" or
+  // "get_action". Kernels that
+  // call State::Find() run with each supported FindImpl, named as in
+  // "find/sse2".
+  std::string kernel;
+  // "warm" runs on a few states that stay in L1, "cold" on copies of every
+  // state, far more than the caches hold, in a shuffled order.
+  std::string variant;
+  long long ops;
+  double ns_per_op;
+};
+
+// Replays trace and times each kernel on its states, ops_per_kernel calls,
+// best of reps. Returns false with error set if a sample doesn't replay.
+bool RunMicrobench(const std::vector<TraceSample>& trace,
+                   long long ops_per_kernel, int reps,
+                   std::vector<MicrobenchResult>* results, std::string* error);
+
+// Times InsertOrImprove() on a ConcurrentVisitedTable from 1, 2, 4 ... up to
+// max_threads threads, each doing ops_per_thread on keys shared by all, 7 in
+// 8 of them already there as in the solver. Results are kernel
+// "concurrent_visited" with variant "threads=N" and the wall time per op of
+// all threads together, after kernel "visited", VisitedTable on one thread.
+void RunVisitedScaling(int max_threads, long long ops_per_thread,
+                       std::vector<MicrobenchResult>* results);
+
+#endif // _GTN_MICROBENCH_H__
@@ -0,0 +1,68 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "microbench.h"
+
+using namespace std;
+
+// solve_microbench record trace_file samples_per_level level...
+//   Writes the expanded states of solving the levels to trace_file.
+// solve_microbench [-n ops] [-r reps] trace_file
+//   Prints the ns per call of each kernel on the states of trace_file as csv.
+// solve_microbench visited [-n ops] max_threads
+//   Prints the ns per op of the visited tables from 1 to max_threads threads,
+//   ops per thread.
+int main(int argc, char **argv) {
+  if (argc >= 4 && strcmp(argv[1], "record") == 0) {
+    vector<string> levels(argv + 4, argv + argc);
+    vector<TraceSample> trace;
+    const int num_traced = RecordTrace(levels, atoi(argv[3]), &trace);
+    if (!WriteTrace(argv[2], trace)) {
+      cout << "Can't write " << argv[2] << endl;
+      exit(3);
+    }
+    cerr << trace.size() << " samples of " << num_traced << " levels" << endl;
+    return 0;
+  }
+  long long ops = 2000000;
+  int reps = 3;
+  string trace_path;
+  const bool scaling = argc >= 2 && strcmp(argv[1], "visited") == 0;
+  for (int i = scaling ? 2 : 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      ops = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      reps = atoi(argv[++i]);
+    } else {
+      trace_path = argv[i];
+    }
+  }
+  vector<TraceSample> trace;
+  const bool usable = scaling ? atoi(trace_path.c_str()) > 0
+                              : !trace_path.empty() &&
+                                    ReadTrace(trace_path, &trace);
+  if (!usable) {
+    cout << "Usage: solve_microbench [-n ops] [-r reps] trace_file" << endl
+         << "       solve_microbench record trace_file samples_per_level "
+         << "level..." << endl
+         << "       solve_microbench visited [-n ops] max_threads" << endl;
+    exit(2);
+  }
+  vector<MicrobenchResult> results;
+  string error;
+  if (scaling) {
+    RunVisitedScaling(atoi(trace_path.c_str()), ops, &results);
+  } else if (!RunMicrobench(trace, ops, reps, &results, &error)) {
+    cout << error << endl;
+    exit(3);
+  }
+  cout << "kernel,variant,ops,ns_per_op" << endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    cout << results[i].kernel << "," << results[i].variant << ","
+         << results[i].ops << "," << results[i].ns_per_op << endl;
+  }
+  return 0;
+}
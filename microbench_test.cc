@@ -0,0 +1,73 @@
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "microbench.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+static const char TRACE_PATH[] = "/tmp/gtn_microbench_test.trace";
+
+TEST(TestMicrobench, RecordAndReplay) {
+  vector<string> levels;
+  levels.push_back("levels/P1L01");
+  levels.push_back("levels/nonexistent");
+  levels.push_back("levels/P4L30");
+  vector<TraceSample> trace;
+  EXPECT_EQ(2, RecordTrace(levels, 5, &trace));
+  // P1L01 expands fewer states than that.
+  ASSERT_LT(5, trace.size());
+  EXPECT_EQ("levels/P1L01", trace[0].level);
+  EXPECT_TRUE(trace[0].moves.empty());
+  EXPECT_EQ("levels/P4L30", trace.back().level);
+  EXPECT_LT(0, trace.back().moves.size());
+
+  ASSERT_TRUE(WriteTrace(TRACE_PATH, trace));
+  vector<TraceSample> read;
+  ASSERT_TRUE(ReadTrace(TRACE_PATH, &read));
+  unlink(TRACE_PATH);
+  ASSERT_EQ(trace.size(), read.size());
+  for (size_t i = 0; i < trace.size(); ++i) {
+    EXPECT_EQ(trace[i].level, read[i].level);
+    EXPECT_EQ(trace[i].moves, read[i].moves);
+  }
+
+  vector<MicrobenchResult> results;
+  string error;
+  ASSERT_TRUE(RunMicrobench(read, 1000, 1, &results, &error)) << error;
+  int num_impls = 0;
+  for (int impl = 0; impl < NUM_FIND_IMPLS; ++impl) {
+    num_impls += FindImplSupported(FindImpl(impl));
+  }
+  // Move, move_occupied, find and find_many with each implementation, warm
+  // and cold.
+  ASSERT_EQ(2 * (4 * num_impls + 3), results.size());
+  EXPECT_EQ("move/scalar", results[0].kernel);
+  EXPECT_EQ("warm", results[0].variant);
+  EXPECT_EQ("cold", results[1].variant);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_LT(0, results[i].ns_per_op) << results[i].kernel;
+  }
+
+  // A move that isn't there.
+  read[0].moves.push_back(make_pair(0, 0));
+  EXPECT_FALSE(RunMicrobench(read, 1000, 1, &results, &error));
+  EXPECT_EQ("Sample 0 of levels/P1L01 doesn't replay", error);
+}
+
+TEST(TestMicrobench, VisitedScaling) {
+  vector<MicrobenchResult> results;
+  RunVisitedScaling(4, 10000, &results);
+  ASSERT_EQ(4, results.size());
+  EXPECT_EQ("visited", results[0].kernel);
+  EXPECT_EQ("concurrent_visited", results[1].kernel);
+  EXPECT_EQ("threads=1", results[1].variant);
+  EXPECT_EQ("threads=4", results[3].variant);
+  EXPECT_EQ(40000, results[3].ops);
+  for (size_t i = 0; i < results.size(); ++i) {
+    EXPECT_LT(0, results[i].ns_per_op) << results[i].variant;
+  }
+}
@@ -0,0 +1,85 @@
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "pages.h"
+
+static const size_t SMALL_PAGE_SIZE = 4096;
+static const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+static size_t RoundUp(size_t bytes, size_t page) {
+  return (bytes + page - 1) / page * page;
+}
+
+const char* PageKindName(PageKind kind) {
+  switch (kind) {
+    case NO_PAGES: return "none";
+    case SMALL_PAGES: return "small";
+    case TRANSPARENT_HUGE_PAGES: return "transparent_huge";
+    case HUGETLB_PAGES: return "hugetlb";
+  }
+  return "unknown";
+}
+
+PageBuffer::PageBuffer() : ptr(NULL), length(0), page_kind(NO_PAGES) {}
+
+PageBuffer::~PageBuffer() {
+  Free();
+}
+
+bool PageBuffer::Allocate(size_t bytes, bool huge) {
+  Free();
+  if (bytes == 0) return true;
+  const int prot = PROT_READ | PROT_WRITE;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (huge && bytes >= HUGE_PAGE_SIZE) {
+    length = RoundUp(bytes, HUGE_PAGE_SIZE);
+    void* p = mmap(NULL, length, prot, flags | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+      ptr = p;
+      page_kind = HUGETLB_PAGES;
+      return true;
+    }
+    // Transparent huge pages only cover aligned 2MB ranges, map one more and
+    // trim the ends.
+    p = mmap(NULL, length + HUGE_PAGE_SIZE, prot, flags, -1, 0);
+    if (p != MAP_FAILED) {
+      char* begin = (char*)p;
+      char* aligned = (char*)RoundUp((uintptr_t)begin, HUGE_PAGE_SIZE);
+      if (aligned > begin) munmap(begin, aligned - begin);
+      munmap(aligned + length, begin + HUGE_PAGE_SIZE - aligned);
+      ptr = aligned;
+      page_kind = madvise(ptr, length, MADV_HUGEPAGE) == 0
+                      ? TRANSPARENT_HUGE_PAGES
+                      : SMALL_PAGES;
+      return true;
+    }
+  }
+  length = RoundUp(bytes, SMALL_PAGE_SIZE);
+  void* p = mmap(NULL, length, prot, flags, -1, 0);
+  if (p == MAP_FAILED) {
+    length = 0;
+    return false;
+  }
+  ptr = p;
+  page_kind = SMALL_PAGES;
+  return true;
+}
+
+void PageBuffer::Free() {
+  if (ptr != NULL) munmap(ptr, length);
+  ptr = NULL;
+  length = 0;
+  page_kind = NO_PAGES;
+}
+
+void PageBuffer::Swap(PageBuffer* other) {
+  void* p = ptr;
+  ptr = other->ptr;
+  other->ptr = p;
+  const size_t l = length;
+  length = other->length;
+  other->length = l;
+  const PageKind k = page_kind;
+  page_kind = other->page_kind;
+  other->page_kind = k;
+}
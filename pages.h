@@ -0,0 +1,48 @@
+#ifndef _GTN_PAGES_H__
+#define _GTN_PAGES_H__
+
+#include <stddef.h>
+
+// What backs a PageBuffer.
+enum PageKind {
+  NO_PAGES,
+  SMALL_PAGES,
+  // madvise(MADV_HUGEPAGE), the kernel may still use small pages.
+  TRANSPARENT_HUGE_PAGES,
+  // MAP_HUGETLB, from the pages reserved in /proc/sys/vm/nr_hugepages.
+  HUGETLB_PAGES,
+};
+
+// "none", "small", "transparent_huge" or "hugetlb".
+const char* PageKindName(PageKind kind);
+
+// Zeroed anonymous memory from mmap() for the big search tables. Pages are
+// only touched when used.
+class PageBuffer {
+ public:
+  PageBuffer();
+  ~PageBuffer();
+
+  // Drops the current memory and maps at least bytes. With huge it tries
+  // HUGETLB_PAGES, then TRANSPARENT_HUGE_PAGES on 2MB aligned memory, then
+  // settles for small pages. Returns false if nothing could be mapped.
+  bool Allocate(size_t bytes, bool huge);
+  void Free();
+  void Swap(PageBuffer* other);
+
+  void* data() const { return ptr; }
+  // Bytes mapped, at least those asked for.
+  size_t size() const { return length; }
+  PageKind kind() const { return page_kind; }
+
+ private:
+  void* ptr;
+  size_t length;
+  PageKind page_kind;
+
+  // Not copyable, owns the mapping.
+  PageBuffer(const PageBuffer&);
+  void operator=(const PageBuffer&);
+};
+
+#endif // _GTN_PAGES_H__
@@ -0,0 +1,43 @@
+#include <string.h>
+#include <string>
+
+#include "pages.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(TestPages, Small) {
+  PageBuffer buffer;
+  EXPECT_EQ(NO_PAGES, buffer.kind());
+  ASSERT_TRUE(buffer.Allocate(100, false));
+  EXPECT_EQ(SMALL_PAGES, buffer.kind());
+  EXPECT_LE(100u, buffer.size());
+  const char* p = (const char*)buffer.data();
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(0, p[i]);
+  buffer.Free();
+  EXPECT_TRUE(buffer.data() == NULL);
+  EXPECT_EQ(NO_PAGES, buffer.kind());
+}
+
+TEST(TestPages, HugeOrFallback) {
+  const size_t bytes = 5 << 20;
+  PageBuffer buffer;
+  ASSERT_TRUE(buffer.Allocate(bytes, true));
+  // Any kind works, depending on what the system allows.
+  EXPECT_NE(NO_PAGES, buffer.kind()) << PageKindName(buffer.kind());
+  EXPECT_LE(bytes, buffer.size());
+  if (buffer.kind() != SMALL_PAGES) {
+    EXPECT_EQ(0u, (size_t)buffer.data() % (2 << 20));
+  }
+  memset(buffer.data(), 1, bytes);
+  PageBuffer other;
+  other.Swap(&buffer);
+  EXPECT_TRUE(buffer.data() == NULL);
+  EXPECT_EQ(1, ((const char*)other.data())[bytes - 1]);
+}
+
+TEST(TestPages, Names) {
+  EXPECT_EQ(string("hugetlb"), PageKindName(HUGETLB_PAGES));
+  EXPECT_EQ(string("transparent_huge"), PageKindName(TRANSPARENT_HUGE_PAGES));
+}
@@ -0,0 +1,122 @@
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string>
+
+#include "perf.h"
+
+using namespace std;
+
+const char* PerfEventName(int event) {
+  static const char* NAMES[NUM_PERF_EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+  };
+  return event >= 0 && event < NUM_PERF_EVENTS ? NAMES[event] : "unknown";
+}
+
+// Type and config of perf_event_attr for event.
+static void EventConfig(int event, perf_event_attr* attr) {
+  switch (event) {
+    case PERF_CYCLES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_L1D_MISSES:
+      attr->type = PERF_TYPE_HW_CACHE;
+      attr->config = PERF_COUNT_HW_CACHE_L1D |
+                     (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case PERF_LLC_MISSES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case PERF_BRANCH_MISSES:
+      attr->type = PERF_TYPE_HARDWARE;
+      attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+  }
+}
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    fds[i] = -1;
+    values[i] = -1;
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  Close();
+}
+
+bool PerfCounters::Open(string* error) {
+  Close();
+  int first_errno = 0;
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    EventConfig(i, &attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[i] < 0 && first_errno == 0) first_errno = errno;
+  }
+  if (Available()) return true;
+  if (error != NULL) {
+    *error = string("perf_event_open: ") + strerror(first_errno);
+  }
+  return false;
+}
+
+void PerfCounters::Close() {
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    if (fds[i] >= 0) close(fds[i]);
+    fds[i] = -1;
+    values[i] = -1;
+  }
+}
+
+bool PerfCounters::Available() const {
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    if (fds[i] >= 0) return true;
+  }
+  return false;
+}
+
+void PerfCounters::Start() {
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    if (fds[i] < 0) continue;
+    ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+    ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+  }
+}
+
+void PerfCounters::Stop() {
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    values[i] = -1;
+    if (fds[i] < 0) continue;
+    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    // value, time enabled, time running.
+    unsigned long long data[3];
+    if (read(fds[i], data, sizeof(data)) != sizeof(data)) continue;
+    if (data[2] == 0) {
+      // Never scheduled.
+      values[i] = data[1] == 0 ? 0 : -1;
+    } else if (data[2] < data[1]) {
+      values[i] = (long long)((double)data[0] * data[1] / data[2]);
+    } else {
+      values[i] = data[0];
+    }
+  }
+}
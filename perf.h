@@ -0,0 +1,49 @@
+#ifndef _GTN_PERF_H__
+#define _GTN_PERF_H__
+
+#include <string>
+
+// Hardware events counted by PerfCounters.
+enum PerfEvent {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,
+  PERF_LLC_MISSES,
+  PERF_BRANCH_MISSES,
+  NUM_PERF_EVENTS,
+};
+
+// "cycles", "instructions" and so on.
+const char* PerfEventName(int event);
+
+// Linux perf_event counters of the calling thread, user space only. Events
+// the kernel or the CPU don't offer read -1, so does everything when
+// perf_event_open() is not allowed, as in most containers. Counts are
+// scaled up when the kernel multiplexes the counters.
+class PerfCounters {
+ public:
+  PerfCounters();
+  ~PerfCounters();
+
+  // Returns whether any event could be opened, error gets why not.
+  bool Open(std::string* error = NULL);
+  void Close();
+  bool Available() const;
+
+  // Resets and starts the counters.
+  void Start();
+  // Stops them and reads the counts since Start().
+  void Stop();
+  // Of the last Stop(), -1 if the event is not available.
+  long long Value(int event) const { return values[event]; }
+
+ private:
+  int fds[NUM_PERF_EVENTS];
+  long long values[NUM_PERF_EVENTS];
+
+  // Not copyable, owns the file descriptors.
+  PerfCounters(const PerfCounters&);
+  void operator=(const PerfCounters&);
+};
+
+#endif // _GTN_PERF_H__
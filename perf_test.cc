@@ -0,0 +1,43 @@
+#include <string>
+
+#include "perf.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(TestPerf, CountsOrDegrades) {
+  PerfCounters perf;
+  EXPECT_FALSE(perf.Available());
+  string error;
+  const bool available = perf.Open(&error);
+  EXPECT_EQ(available, perf.Available());
+  perf.Start();
+  volatile long long sum = 0;
+  for (int i = 0; i < 1000000; ++i) sum += i;
+  perf.Stop();
+  if (!available) {
+    // As in containers without perf_event access.
+    EXPECT_EQ(0, error.find("perf_event_open: "));
+    for (int i = 0; i < NUM_PERF_EVENTS; ++i) EXPECT_EQ(-1, perf.Value(i));
+    return;
+  }
+  bool counted = false;
+  for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+    EXPECT_LE(-1, perf.Value(i));
+    counted = counted || perf.Value(i) > 0;
+  }
+  EXPECT_TRUE(counted);
+  if (perf.Value(PERF_INSTRUCTIONS) >= 0) {
+    EXPECT_LT(1000000, perf.Value(PERF_INSTRUCTIONS));
+  }
+  perf.Close();
+  EXPECT_FALSE(perf.Available());
+  EXPECT_EQ(-1, perf.Value(PERF_CYCLES));
+}
+
+TEST(TestPerf, Names) {
+  EXPECT_STREQ("cycles", PerfEventName(PERF_CYCLES));
+  EXPECT_STREQ("branch_misses", PerfEventName(PERF_BRANCH_MISSES));
+  EXPECT_STREQ("unknown", PerfEventName(NUM_PERF_EVENTS));
+}
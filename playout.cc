@@ -0,0 +1,126 @@
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "playout.h"
+#include "utils.h"
+
+using namespace std;
+
+PlayoutStats::PlayoutStats()
+  : num_playouts(0),
+    num_moves(0),
+    total_length(0),
+    num_wins(0),
+    num_losses(0),
+    elapsed_us(0) {}
+
+void PlayoutStats::Merge(const PlayoutStats& other) {
+  num_playouts += other.num_playouts;
+  num_moves += other.num_moves;
+  total_length += other.total_length;
+  num_wins += other.num_wins;
+  num_losses += other.num_losses;
+  if (other.elapsed_us > elapsed_us) elapsed_us = other.elapsed_us;
+}
+
+double PlayoutStats::MovesPerSec() const {
+  return elapsed_us > 0 ? num_moves * 1e6 / elapsed_us : 0;
+}
+
+// xorshift64*, plenty for picking moves.
+static inline unsigned long long NextRandom(unsigned long long* s) {
+  *s ^= *s >> 12;
+  *s ^= *s << 25;
+  *s ^= *s >> 27;
+  return *s * 2685821657736338717ULL;
+}
+
+template <class G>
+PlayoutStats RandomPlayouts(const BasicBoard<G>& board,
+                            const BasicState<G>& start, long long num_playouts,
+                            int max_length, unsigned long long seed) {
+  typedef BasicState<G> State;
+  PlayoutStats stats;
+  // The state is never 0.
+  unsigned long long random = seed * 0x9E3779B97F4A7C15ULL + 1;
+  State states[2];
+  // Tile index times 4 plus direction of the untried moves.
+  int moves[G::MAX_TILES * 4];
+  const long long start_us = NowMicros();
+  for (long long p = 0; p < num_playouts; ++p) {
+    int curr = 0;
+    states[0] = start;
+    states[0].ClearHistory();
+    int length = 0;
+    bool over = false;
+    while (!over && length < max_length) {
+      const State& s = states[curr];
+      int num_moves = 0;
+      for (int t = 0; t < s.NumTiles(); ++t) {
+        const Tile& tile = s.GetTile(t);
+        if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+        for (int dir = 0; dir < 4; ++dir) moves[num_moves++] = t * 4 + dir;
+      }
+      bool moved = false;
+      while (!moved && num_moves > 0) {
+        const int i = NextRandom(&random) % num_moves;
+        const int move = moves[i];
+        moves[i] = moves[--num_moves];
+        int slide_len;
+        const int res = s.Move(board, move / 4, move % 4, &states[1 - curr],
+                               &slide_len);
+        ++stats.num_moves;
+        if (res == State::WIN) {
+          ++stats.num_wins;
+          over = true;
+        } else if (res == State::LOSE) {
+          ++stats.num_losses;
+          over = true;
+        }
+        moved = over || slide_len > 0;
+      }
+      if (!moved) break;
+      ++length;
+      curr = 1 - curr;
+      // Move() appends to a history of MAX_HISTORY moves.
+      states[curr].ClearHistory();
+    }
+    stats.total_length += length;
+    ++stats.num_playouts;
+  }
+  stats.elapsed_us = NowMicros() - start_us;
+  return stats;
+}
+
+template <class G>
+PlayoutStats ParallelPlayouts(const BasicBoard<G>& board,
+                              const BasicState<G>& start, int num_threads,
+                              long long playouts_per_thread, int max_length,
+                              vector<PlayoutStats>* per_thread) {
+  vector<PlayoutStats> stats(num_threads);
+  vector<thread> threads;
+  const long long start_us = NowMicros();
+  for (int i = 0; i < num_threads; ++i) {
+    threads.push_back(thread([&, i]() {
+      stats[i] = RandomPlayouts(board, start, playouts_per_thread, max_length,
+                                i + 1);
+    }));
+  }
+  for (int i = 0; i < num_threads; ++i) threads[i].join();
+  PlayoutStats total;
+  for (int i = 0; i < num_threads; ++i) total.Merge(stats[i]);
+  total.elapsed_us = NowMicros() - start_us;
+  if (per_thread != NULL) *per_thread = stats;
+  return total;
+}
+
+#define INSTANTIATE(G)                                                     \
+  template PlayoutStats RandomPlayouts<G>(                                 \
+      const BasicBoard<G>&, const BasicState<G>&, long long, int,          \
+      unsigned long long);                                                 \
+  template PlayoutStats ParallelPlayouts<G>(                               \
+      const BasicBoard<G>&, const BasicState<G>&, int, long long, int,     \
+      vector<PlayoutStats>*);
+GTN_FOR_EACH_GEOMETRY(INSTANTIATE)
+#undef INSTANTIATE
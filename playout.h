@@ -0,0 +1,43 @@
+#ifndef _GTN_PLAYOUT_H__
+#define _GTN_PLAYOUT_H__
+
+#include <vector>
+
+#include "board.h"
+
+// Counts of random playouts.
+struct PlayoutStats {
+  PlayoutStats();
+  // Adds up the counts, keeps the longer time.
+  void Merge(const PlayoutStats& other);
+  double MovesPerSec() const;
+
+  long long num_playouts;
+  // State::Move() calls, including those that didn't move the tile.
+  long long num_moves;
+  // Moves that slid a tile, summed over the playouts.
+  long long total_length;
+  long long num_wins;
+  long long num_losses;
+  long long elapsed_us;
+};
+
+// Plays num_playouts random games from start. Every step tries the moves of
+// the relevant tiles in random order until one slides a tile, a game ends on
+// a win, a loss, max_length moves or when nothing moves. Works on two states
+// on the stack, without heap allocation. The same seed plays the same games.
+template <class G>
+PlayoutStats RandomPlayouts(const BasicBoard<G>& board,
+                            const BasicState<G>& start, long long num_playouts,
+                            int max_length, unsigned long long seed);
+
+// RandomPlayouts() on num_threads threads with seeds 1, 2, ... per_thread, if
+// not NULL, gets the stats of each thread. Returns their sum, timed from the
+// start of the first to the end of the last thread.
+template <class G>
+PlayoutStats ParallelPlayouts(const BasicBoard<G>& board,
+                              const BasicState<G>& start, int num_threads,
+                              long long playouts_per_thread, int max_length,
+                              std::vector<PlayoutStats>* per_thread);
+
+#endif // _GTN_PLAYOUT_H__
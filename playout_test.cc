@@ -0,0 +1,73 @@
+#include <vector>
+
+#include "board.h"
+#include "playout.h"
+#include "rules.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+#include "testboards.h"
+
+static Rules REAL_RULES = Rules("rules-real.csv");
+
+TEST(TestPlayout, Counts) {
+  Board b(B003, REAL_RULES);
+  State s(B003);
+  const PlayoutStats stats = RandomPlayouts(b, s, 1000, 50, 1);
+  EXPECT_EQ(1000, stats.num_playouts);
+  EXPECT_GT(stats.num_wins, 0);
+  EXPECT_LE(stats.num_wins + stats.num_losses, stats.num_playouts);
+  EXPECT_GE(stats.num_moves, stats.total_length);
+  EXPECT_LE(stats.total_length, 1000 * 50);
+}
+
+TEST(TestPlayout, SameSeedSameGames) {
+  Board b(B003, REAL_RULES);
+  State s(B003);
+  const PlayoutStats a = RandomPlayouts(b, s, 200, 50, 7);
+  const PlayoutStats c = RandomPlayouts(b, s, 200, 50, 7);
+  EXPECT_EQ(a.num_moves, c.num_moves);
+  EXPECT_EQ(a.total_length, c.total_length);
+  EXPECT_EQ(a.num_wins, c.num_wins);
+  EXPECT_EQ(a.num_losses, c.num_losses);
+}
+
+// The squirrel can't reach the goal but can keep moving.
+static const char NO_WIN[] =
+    "##########"
+    "# a   #  #"
+    "#     #  #"
+    "#     # b#"
+    "#     #  #"
+    "#     #  #"
+    "#     #  #"
+    "##########";
+
+TEST(TestPlayout, LongerThanHistory) {
+  Board b(NO_WIN, REAL_RULES);
+  State s(NO_WIN);
+  const PlayoutStats stats = RandomPlayouts(b, s, 10, 3 * MAX_HISTORY, 1);
+  EXPECT_EQ(10, stats.num_playouts);
+  EXPECT_EQ(0, stats.num_wins);
+  EXPECT_EQ(10 * 3 * MAX_HISTORY, stats.total_length);
+}
+
+TEST(TestPlayout, Parallel) {
+  Board b(B003, REAL_RULES);
+  State s(B003);
+  vector<PlayoutStats> per_thread;
+  const PlayoutStats total = ParallelPlayouts(b, s, 3, 100, 50, &per_thread);
+  ASSERT_EQ(3u, per_thread.size());
+  long long num_moves = 0;
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(100, per_thread[i].num_playouts);
+    num_moves += per_thread[i].num_moves;
+    // Thread i plays the games of seed i + 1.
+    EXPECT_EQ(RandomPlayouts(b, s, 100, 50, i + 1).num_moves,
+              per_thread[i].num_moves);
+  }
+  EXPECT_EQ(300, total.num_playouts);
+  EXPECT_EQ(num_moves, total.num_moves);
+}
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "log.h"
+#include "rank.h"
+
+using namespace std;
+
+static const unsigned long long SATURATED =
+    numeric_limits<unsigned long long>::max();
+// Most counts combinations the ranker tabulates.
+static const long long MAX_COUNTS = 1 << 20;
+
+static unsigned long long SatAdd(unsigned long long a, unsigned long long b) {
+  return a > SATURATED - b ? SATURATED : a + b;
+}
+
+static unsigned long long SatMul(unsigned long long a, unsigned long long b) {
+  return b != 0 && a > SATURATED / b ? SATURATED : a * b;
+}
+
+template <class G>
+BasicStateRanker<G>::BasicStateRanker(const Board& board_, const State& start)
+  : board(board_), slot_value(NUM_TYPES, -1), dyn_index(NUM_TYPES, -1),
+    cell_index(G::BOARD_SIZE, -1), placements(0), valid(false), size(0),
+    size_estimate(0) {
+  // Types the relevant tiles may take, and those of tiles that may have moved.
+  int any_mask = 0;
+  int moved_mask = 0;
+  vector<int> moved_masks;
+  for (int i = 0; i < start.NumTiles(); ++i) {
+    const Tile& tile = start.GetTile(i);
+    if (!board.IsRelevant(tile.pos)) {
+      irrelevant.push_back(tile);
+      continue;
+    }
+    const int mask = board.BecomeMask(tile.type);
+    int moved = 0;
+    for (int u = 0; u < NUM_TYPES; ++u) {
+      if ((mask & (1 << u)) && MOVEABLE[u]) moved |= board.BecomeMask(u);
+    }
+    any_mask |= mask;
+    moved_mask |= moved;
+    moved_masks.push_back(moved);
+  }
+  for (int t = 0; t < NUM_TYPES; ++t) {
+    if ((any_mask & (1 << t)) && !MOVEABLE[t]) {
+      slot_value[t] = slot_types.size();
+      slot_types.push_back(t);
+    }
+    if (moved_mask & (1 << t)) {
+      dyn_index[t] = dyn_types.size();
+      dyn_types.push_back(t);
+      int count = 0;
+      for (size_t i = 0; i < moved_masks.size(); ++i) {
+        if (moved_masks[i] & (1 << t)) ++count;
+      }
+      max_count.push_back(count);
+    }
+  }
+  slot_radix = slot_types.size() + 1;
+  slot_pos.resize(board.NumStatic());
+  for (int pos = 0; pos < G::BOARD_SIZE; ++pos) {
+    if (board.StaticSlot(pos) >= 0) slot_pos[board.StaticSlot(pos)] = pos;
+    if (board.IsOpen(pos) && board.IsRelevant(pos)) {
+      cell_index[pos] = cells.size();
+      cells.push_back(pos);
+    }
+  }
+  const int n = cells.size();
+  binomial.assign(n + 1, vector<unsigned long long>(n + 1, 0));
+  vector<vector<double> > binomial_d(n + 1, vector<double>(n + 1, 0));
+  for (int i = 0; i <= n; ++i) {
+    binomial[i][0] = 1;
+    binomial_d[i][0] = 1;
+    for (int k = 1; k <= i; ++k) {
+      binomial[i][k] = SatAdd(binomial[i - 1][k - 1], binomial[i - 1][k]);
+      binomial_d[i][k] = binomial_d[i - 1][k - 1] + binomial_d[i - 1][k];
+    }
+  }
+
+  long long num_counts = 1;
+  for (size_t d = 0; d < dyn_types.size(); ++d) {
+    stride.push_back(num_counts);
+    num_counts *= max_count[d] + 1;
+    if (num_counts > MAX_COUNTS) {
+      size_estimate = numeric_limits<double>::infinity();
+      return;
+    }
+  }
+  // Placements of each counts combination, in order.
+  bool saturated = false;
+  double placements_d = 0;
+  offset.resize(num_counts);
+  for (long long c = 0; c < num_counts; ++c) {
+    offset[c] = placements;
+    unsigned long long p = 1;
+    double p_d = 1;
+    int rem = n;
+    for (size_t d = 0; d < dyn_types.size() && p != 0; ++d) {
+      const int count = c / stride[d] % (max_count[d] + 1);
+      if (count > rem) {
+        p = 0;
+        p_d = 0;
+        break;
+      }
+      p = SatMul(p, binomial[rem][count]);
+      p_d *= binomial_d[rem][count];
+      rem -= count;
+    }
+    placements = SatAdd(placements, p);
+    placements_d += p_d;
+  }
+  saturated = placements == SATURATED;
+  size = placements;
+  size_estimate = placements_d;
+  for (int i = 0; i < board.NumStatic(); ++i) {
+    size = SatMul(size, slot_radix);
+    size_estimate *= slot_radix;
+  }
+  valid = !saturated && size != SATURATED && size < (1ULL << 63);
+  LOG(1) << "rank space: " << size_estimate << " slots: " << board.NumStatic()
+         << "x" << slot_radix << " dynamic types: " << dyn_types.size()
+         << " cells: " << n << endl;
+}
+
+template <class G>
+unsigned long long BasicStateRanker<G>::Rank(const State& state) const {
+  vector<int> slots(board.NumStatic(), slot_radix - 1);
+  // Cell indices of the dynamic tiles, sorted by type as the state is.
+  vector<vector<int> > by_type(dyn_types.size());
+  for (int i = 0; i < state.NumTiles(); ++i) {
+    const Tile& tile = state.GetTile(i);
+    if (!board.IsRelevant(tile.pos)) continue;
+    const int slot = board.StaticSlot(tile.pos);
+    if (slot >= 0 && !MOVEABLE[tile.type]) {
+      if (slot_value[tile.type] < 0) return size;
+      slots[slot] = slot_value[tile.type];
+    } else {
+      if (dyn_index[tile.type] < 0) return size;
+      by_type[dyn_index[tile.type]].push_back(cell_index[tile.pos]);
+    }
+  }
+  for (size_t d = 0; d < dyn_types.size(); ++d) {
+    if ((int)by_type[d].size() > max_count[d]) return size;
+  }
+  unsigned long long r = 0;
+  for (int i = 0; i < board.NumStatic(); ++i) r = r * slot_radix + slots[i];
+
+  long long c = 0;
+  for (size_t d = 0; d < dyn_types.size(); ++d) {
+    c += by_type[d].size() * stride[d];
+  }
+  vector<bool> taken(cells.size(), false);
+  unsigned long long within = 0;
+  int rem = cells.size();
+  for (size_t d = 0; d < dyn_types.size(); ++d) {
+    vector<int>& idx = by_type[d];
+    sort(idx.begin(), idx.end());
+    unsigned long long sub = 0;
+    for (size_t i = 0; i < idx.size(); ++i) {
+      // Index among the cells not taken by the previous types.
+      int free_idx = idx[i];
+      for (int j = 0; j < idx[i]; ++j) free_idx -= taken[j];
+      sub += binomial[free_idx][i + 1];
+    }
+    for (size_t i = 0; i < idx.size(); ++i) taken[idx[i]] = true;
+    within = within * binomial[rem][idx.size()] + sub;
+    rem -= idx.size();
+  }
+  return r * placements + offset[c] + within;
+}
+
+template <class G>
+void BasicStateRanker<G>::Unrank(unsigned long long r, State* state) const {
+  unsigned long long within = r % placements;
+  unsigned long long slots = r / placements;
+  const long long c =
+      upper_bound(offset.begin(), offset.end(), within) - offset.begin() - 1;
+  within -= offset[c];
+
+  state->history_len = 0;
+  state->num_tiles = 0;
+  for (size_t i = 0; i < irrelevant.size(); ++i) {
+    state->t[state->num_tiles++] = irrelevant[i];
+  }
+  for (int i = board.NumStatic() - 1; i >= 0; --i) {
+    const int value = slots % slot_radix;
+    slots /= slot_radix;
+    if (value == slot_radix - 1) continue;
+    Tile& tile = state->t[state->num_tiles++];
+    tile = Tile();
+    tile.pos = slot_pos[i];
+    tile.type = slot_types[value];
+  }
+
+  // The combination of each type, last type in the lowest digits.
+  const int num_dyn = dyn_types.size();
+  vector<int> counts(num_dyn);
+  vector<int> rems(num_dyn);
+  int rem = cells.size();
+  for (int d = 0; d < num_dyn; ++d) {
+    counts[d] = c / stride[d] % (max_count[d] + 1);
+    rems[d] = rem;
+    rem -= counts[d];
+  }
+  vector<unsigned long long> subs(num_dyn);
+  for (int d = num_dyn - 1; d >= 0; --d) {
+    const unsigned long long radix = binomial[rems[d]][counts[d]];
+    subs[d] = within % radix;
+    within /= radix;
+  }
+  vector<bool> taken(cells.size(), false);
+  for (int d = 0; d < num_dyn; ++d) {
+    vector<int> idx;
+    unsigned long long sub = subs[d];
+    for (int k = counts[d]; k >= 1; --k) {
+      int v = k - 1;
+      while (v + 1 < rems[d] && binomial[v + 1][k] <= sub) ++v;
+      sub -= binomial[v][k];
+      // Back from the index among the free cells to the cell index.
+      int cell = -1;
+      for (int free_idx = -1; free_idx < v; ) {
+        if (!taken[++cell]) ++free_idx;
+      }
+      idx.push_back(cell);
+    }
+    for (size_t i = 0; i < idx.size(); ++i) {
+      taken[idx[i]] = true;
+      Tile& tile = state->t[state->num_tiles++];
+      tile = Tile();
+      tile.pos = cells[idx[i]];
+      tile.type = dyn_types[d];
+    }
+  }
+  state->Sort();
+}
+
+template <class G>
+EnumerationResult EnumerateStates(const BasicBoard<G>& board,
+                                  const BasicState<G>& start) {
+  typedef BasicState<G> State;
+  EnumerationResult res;
+  BasicStateRanker<G> ranker(board, start);
+  res.rank_space = ranker.SizeEstimate();
+  if (!ranker.Valid() || ranker.Size() > MAX_RANK_BITS) {
+    res.num_states = -1;
+    return res;
+  }
+  vector<unsigned long long> visited((ranker.Size() + 63) / 64, 0);
+  vector<unsigned long long> layer(1, ranker.Rank(start));
+  if (layer[0] >= ranker.Size()) {
+    res.num_states = -1;
+    return res;
+  }
+  visited[layer[0] / 64] |= 1ULL << (layer[0] % 64);
+  res.num_states = 1;
+  while (!layer.empty()) {
+    ++res.num_layers;
+    vector<unsigned long long> next_layer;
+    for (size_t i = 0; i < layer.size(); ++i) {
+      State curr;
+      ranker.Unrank(layer[i], &curr);
+      for (int tile_index = 0; tile_index < curr.NumTiles(); ++tile_index) {
+        const Tile& tile = curr.GetTile(tile_index);
+        if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+        for (int di = 0; di < 4; ++di) {
+          State next;
+          int move_res = curr.Move(board, tile_index, di, &next);
+          if (move_res == State::LOSE) continue;
+          if (move_res == State::WIN) {
+            if (res.win_moves < 0) res.win_moves = res.num_layers;
+            continue;
+          }
+          const unsigned long long r = ranker.Rank(next);
+          // A state outside the rank space, the enumeration can't be trusted.
+          if (r >= ranker.Size()) {
+            res.num_states = -1;
+            return res;
+          }
+          unsigned long long& word = visited[r / 64];
+          const unsigned long long bit = 1ULL << (r % 64);
+          if (word & bit) continue;
+          word |= bit;
+          next_layer.push_back(r);
+          ++res.num_states;
+        }
+      }
+    }
+    layer.swap(next_layer);
+  }
+  return res;
+}
+
+#define INSTANTIATE(G)                                                   \
+  template class BasicStateRanker<G>;                                    \
+  template EnumerationResult EnumerateStates<G>(const BasicBoard<G>&,    \
+                                                const BasicState<G>&);
+GTN_FOR_EACH_GEOMETRY(INSTANTIATE)
+#undef INSTANTIATE
@@ -0,0 +1,96 @@
+#ifndef _GTN_RANK_H__
+#define _GTN_RANK_H__
+
+#include <vector>
+
+#include "board.h"
+
+// Largest bit vector EnumerateStates() allocates, 512MB.
+static const unsigned long long MAX_RANK_BITS = 1ULL << 32;
+
+// Maps the states of a level to 0 .. Size()-1 and back.
+//
+// A state is the type on each static slot of the board, or none, plus the
+// cells of the other relevant tiles by type. Tiles of the same type are
+// interchangeable, so for counts c_1 .. c_k of the k dynamic types over the N
+// cells tiles can be on there are N! / (c_1! .. c_k! (N - c_1 - .. - c_k)!)
+// placements. The rank is the slots as a mixed radix number, then the offset
+// of the counts among all possible counts, then the placement: the cells of
+// each type in turn as a combination of the cells not taken yet.
+//
+// Every reachable state has a rank, but not every rank is a reachable state.
+template <class G>
+class BasicStateRanker {
+ public:
+  typedef BasicBoard<G> Board;
+  typedef BasicState<G> State;
+
+  BasicStateRanker(const Board& board, const State& start);
+
+  // Whether every state fits in 63 bits. Rank() and Unrank() need it.
+  bool Valid() const { return valid; }
+  unsigned long long Size() const { return size; }
+  // Number of ranks, even when it doesn't fit.
+  double SizeEstimate() const { return size_estimate; }
+
+  // Size() for states with tiles no state of the level has.
+  unsigned long long Rank(const State& state) const;
+  // The state of rank r. Its history is empty.
+  void Unrank(unsigned long long r, State* state) const;
+
+ private:
+  const Board& board;
+  // Tiles left out of the search, in every state.
+  std::vector<Tile> irrelevant;
+
+  // Values of a static slot: slot_types[i] for i < slot_radix - 1, empty for
+  // slot_radix - 1.
+  std::vector<int> slot_types;
+  std::vector<int> slot_value;  // By type, -1 if never on a slot.
+  int slot_radix;
+  std::vector<int> slot_pos;
+
+  // Types and cells of the other tiles.
+  std::vector<int> dyn_types;
+  std::vector<int> dyn_index;   // By type, -1 if never dynamic.
+  std::vector<int> max_count;   // By dyn_types index.
+  std::vector<int> cells;
+  std::vector<int> cell_index;  // By position, -1 if not in cells.
+
+  // Counts by dyn_types index are numbered as a mixed radix number with
+  // digits of max_count + 1. offset is the first rank of each, within the
+  // placements of one slot configuration.
+  std::vector<unsigned long long> offset;
+  std::vector<long long> stride;
+  unsigned long long placements;
+  // binomial[n][k], saturated.
+  std::vector<std::vector<unsigned long long> > binomial;
+
+  bool valid;
+  unsigned long long size;
+  double size_estimate;
+};
+
+typedef BasicStateRanker<StandardGeometry> StateRanker;
+
+struct EnumerationResult {
+  EnumerationResult()
+    : num_states(0), num_layers(0), win_moves(-1), rank_space(0) {}
+  // Reachable states, including the start.
+  long long num_states;
+  // Breadth first layers, the start is layer 0.
+  int num_layers;
+  // Fewest moves to win, -1 if there is no win.
+  int win_moves;
+  // Size of the rank space and so of the visited bit vector.
+  double rank_space;
+};
+
+// Breadth first enumeration of the states reachable from start, with one
+// visited bit per rank. Gives up with num_states = -1 when the rank space is
+// larger than MAX_RANK_BITS, or when a state has no rank.
+template <class G>
+EnumerationResult EnumerateStates(const BasicBoard<G>& board,
+                                  const BasicState<G>& start);
+
+#endif // _GTN_RANK_H__
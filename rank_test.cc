@@ -0,0 +1,115 @@
+#include <deque>
+#include <map>
+#include <set>
+
+#include "board.h"
+#include "convert.h"
+#include "rank.h"
+#include "rules.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+#include "testboards.h"
+
+static const Rules REAL_RULES = Rules("rules-real.csv");
+
+typedef StateKey<MAX_KEY_WORDS> Key;
+
+// Breadth first over the states reachable from the start of bs with a map of
+// keys, checking that the ranks are in range, unique and round trip.
+// Returns the number of states.
+long long CheckRanks(const char* bs, int max_states) {
+  Board b(bs, REAL_RULES);
+  State start(bs);
+  StateRanker ranker(b, start);
+  EXPECT_TRUE(ranker.Valid());
+  map<Key, unsigned long long> seen;
+  set<unsigned long long> ranks;
+  deque<State> queue(1, start);
+  Key key;
+  start.Hash(b, &key);
+  seen[key] = ranker.Rank(start);
+  while (!queue.empty() && (int)seen.size() < max_states) {
+    State curr = queue.front();
+    queue.pop_front();
+    curr.ClearHistory();
+    for (int ti = 0; ti < curr.NumTiles(); ++ti) {
+      if (!MOVEABLE[curr.GetTile(ti).type]) continue;
+      for (int di = 0; di < 4; ++di) {
+        State next;
+        if (curr.Move(b, ti, di, &next) != 0) continue;
+        next.Hash(b, &key);
+        if (seen.count(key)) continue;
+        const unsigned long long r = ranker.Rank(next);
+        EXPECT_LT(r, ranker.Size());
+        EXPECT_TRUE(ranks.insert(r).second);
+        State back;
+        ranker.Unrank(r, &back);
+        EXPECT_EQ(r, ranker.Rank(back));
+        Key back_key;
+        back.Hash(b, &back_key);
+        EXPECT_TRUE(key == back_key);
+        seen[key] = r;
+        queue.push_back(next);
+      }
+    }
+  }
+  return seen.size();
+}
+
+TEST(TestRank, RoundTrip) {
+  CheckRanks(B001, 1000);
+  CheckRanks(B002, 1000);
+  CheckRanks(B003, 1000);
+  CheckRanks(B004, 1000);
+  CheckRanks(B005, 1000);
+}
+
+TEST(TestRank, TooManyStates) {
+  Board b(B006, REAL_RULES);
+  State s(B006);
+  StateRanker ranker(b, s);
+  EXPECT_FALSE(ranker.Valid());
+  EXPECT_LT(9.3e18, ranker.SizeEstimate());
+  EXPECT_EQ(-1, EnumerateStates(b, s).num_states);
+}
+
+TEST(TestRank, SingleTileIsDense) {
+  // Only the squirrel: no slots, and a rank for no squirrel plus one per cell.
+  const char* bs =
+    "##########"
+    "# b      #"
+    "#        #"
+    "#        #"
+    "#        #"
+    "#        #"
+    "#        #"
+    "##########";
+  Board b(bs, REAL_RULES);
+  State start(bs);
+  StateRanker ranker(b, start);
+  ASSERT_TRUE(ranker.Valid());
+  EXPECT_EQ(1 + 6 * 8, ranker.Size());
+  for (unsigned long long r = 0; r < ranker.Size(); ++r) {
+    State s;
+    ranker.Unrank(r, &s);
+    EXPECT_EQ(r == 0 ? 0 : 1, s.NumTiles());
+    EXPECT_EQ(r, ranker.Rank(s));
+  }
+}
+
+TEST(TestRank, Enumerate) {
+  // Same state counts as the map based search above.
+  EnumerationResult res = EnumerateStates(Board(B002, REAL_RULES), State(B002));
+  EXPECT_EQ(CheckRanks(B002, 1000000), res.num_states);
+  EXPECT_EQ(4, res.win_moves);
+  EXPECT_LE(res.num_states, res.rank_space);
+  res = EnumerateStates(Board(B003, REAL_RULES), State(B003));
+  EXPECT_EQ(CheckRanks(B003, 1000000), res.num_states);
+  EXPECT_EQ(6, res.win_moves);
+  res = EnumerateStates(Board(B005, REAL_RULES), State(B005));
+  EXPECT_EQ(5, res.win_moves);
+  EXPECT_LT(0, res.num_layers);
+}
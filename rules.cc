@@ -7,6 +7,7 @@
 
 #include "convert.h"
 #include "rules.h"
+#include "utils.h"
 
 using namespace std;
 
@@ -32,6 +33,27 @@ string PrintActions(const Action *a, int num_action) {
   return ss.str();
 }
 
+unsigned long long Rules::Fingerprint() const {
+  unsigned long long h = HashBytes(NULL, 0);
+  for (int a1 = 0; a1 < NUM_ANIMALS; ++a1) {
+    for (int a2 = 0; a2 < NUM_ANIMALS; ++a2) {
+      for (int r = 0; r < NUM_RELATIONS; ++r) {
+        const Action a = GetAction(a1, a2, r);
+        // Field by field, dummy_ is not always set.
+        const unsigned char fields[] = {
+          (unsigned char)a.exists, (unsigned char)a.won,
+          (unsigned char)a.lost, (unsigned char)a.prio,
+          (unsigned char)a.static_old_animal,
+          (unsigned char)a.moving_new_animal,
+          (unsigned char)a.static_new_animal,
+        };
+        h = HashBytes(fields, sizeof(fields), h);
+      }
+    }
+  }
+  return h;
+}
+
 void Rules::Initialize() {
   Action action;
   action.won = 0;
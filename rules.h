@@ -37,6 +37,9 @@ class Rules {
     return rules[moving_animal][static_animal][relation];
   }
 
+  // Hash of every action, e.g. to tell apart results of different rules.
+  unsigned long long Fingerprint() const;
+
  protected:
   // dim: allat1 x allat2 x relation
   Action rules[NUM_ANIMALS][NUM_ANIMALS][NUM_RELATIONS];
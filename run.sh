@@ -1,5 +1,14 @@
 #/bin/bash
-echo "level name, min solution length, solution, number of moves, max num candidates in mem, num visited states, visited state improved, visited state dropped"
+# GTN_SOLUTION_CACHE=solutions.cache reuses the solutions of earlier runs.
+# The cache doesn't know the solver, so the stats it gives back may be of an
+# older search. Leave it unset when regenerating results.
+# GTN_PERF=1 adds hardware counter columns, empty where perf events are not
+# available.
+header="level name, min solution length, solution, number of moves, max num candidates in mem, num visited states, visited state improved, visited state dropped"
+if [ -n "$GTN_PERF" ]; then
+  header="$header, ipc, l1d misses per expanded, llc misses per expanded, branch misses per expanded"
+fi
+echo "$header"
 for i in `ls levels/P*L*`
 do
 #echo '------------------------------'
@@ -1,4 +1,7 @@
 #/bin/bash
+# GTN_SOLUTION_CACHE=solutions.cache reuses the solutions of earlier runs.
+# The cache doesn't know the solver, so the stats it gives back may be of an
+# older search. Leave it unset when regenerating results.
 rm $1
 
 echo "ACG - 'GOLDEN ACORN'" >> $1
@@ -0,0 +1,429 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "level.h"
+#include "rules.h"
+#include "server.h"
+#include "solve.h"
+#include "utils.h"
+
+using namespace std;
+
+static const Rules REAL_RULES = Rules("rules-real.csv");
+
+////////////////////////////////////////////////////////////////////////////////
+// JSON
+////////////////////////////////////////////////////////////////////////////////
+
+static string JsonEscape(const string& s) {
+  string out;
+  for (size_t i = 0; i < s.size(); ++i) {
+    const unsigned char c = s[i];
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (c < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", c);
+      out += buf;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// Just enough of a JSON parser for flat request objects.
+class JsonReader {
+ public:
+  explicit JsonReader(const string& s) : s(s), i(0) {}
+
+  void SkipSpace() {
+    while (i < s.size() && isspace((unsigned char)s[i])) ++i;
+  }
+
+  bool Consume(char c) {
+    SkipSpace();
+    if (i < s.size() && s[i] == c) {
+      ++i;
+      return true;
+    }
+    return false;
+  }
+
+  bool AtEnd() {
+    SkipSpace();
+    return i == s.size();
+  }
+
+  bool ReadString(string* out) {
+    if (!Consume('"')) return false;
+    out->clear();
+    while (i < s.size() && s[i] != '"') {
+      char c = s[i++];
+      if (c == '\\') {
+        if (i >= s.size()) return false;
+        c = s[i++];
+        switch (c) {
+          case 'n': c = '\n'; break;
+          case 't': c = '\t'; break;
+          case 'r': c = '\r'; break;
+          case 'b': c = '\b'; break;
+          case 'f': c = '\f'; break;
+          case 'u':
+            // Only ASCII is of any use in a level.
+            if (i + 4 > s.size()) return false;
+            c = strtol(s.substr(i, 4).c_str(), NULL, 16);
+            i += 4;
+            break;
+        }
+      }
+      *out += c;
+    }
+    return Consume('"');
+  }
+
+  bool ReadNumber(long long* out) {
+    SkipSpace();
+    const char* start = s.c_str() + i;
+    char* end;
+    *out = strtoll(start, &end, 10);
+    if (end == start) return false;
+    i += end - start;
+    // Ignore fractions and exponents.
+    while (i < s.size() && (isdigit((unsigned char)s[i]) || s[i] == '.' ||
+                            s[i] == 'e' || s[i] == 'E' || s[i] == '+' ||
+                            s[i] == '-')) {
+      ++i;
+    }
+    return true;
+  }
+
+  bool ReadBool(bool* out) {
+    SkipSpace();
+    if (s.compare(i, 4, "true") == 0) {
+      *out = true;
+      i += 4;
+      return true;
+    }
+    if (s.compare(i, 5, "false") == 0) {
+      *out = false;
+      i += 5;
+      return true;
+    }
+    return false;
+  }
+
+  bool ReadStringArray(vector<string>* out) {
+    if (!Consume('[')) return false;
+    out->clear();
+    if (Consume(']')) return true;
+    do {
+      string value;
+      if (!ReadString(&value)) return false;
+      out->push_back(value);
+    } while (Consume(','));
+    return Consume(']');
+  }
+
+  // Skips true, false, null, numbers and strings.
+  bool SkipValue() {
+    SkipSpace();
+    if (i < s.size() && s[i] == '"') {
+      string ignored;
+      return ReadString(&ignored);
+    }
+    const char* words[] = { "true", "false", "null" };
+    for (int w = 0; w < 3; ++w) {
+      if (s.compare(i, strlen(words[w]), words[w]) == 0) {
+        i += strlen(words[w]);
+        return true;
+      }
+    }
+    long long ignored;
+    return ReadNumber(&ignored);
+  }
+
+ private:
+  const string& s;
+  size_t i;
+};
+
+bool ParseRequest(const string& line, SolveRequest* req, string* error) {
+  JsonReader r(line);
+  if (!r.Consume('{')) {
+    *error = "Request is not a JSON object";
+    return false;
+  }
+  if (!r.Consume('}')) {
+    do {
+      string key;
+      if (!r.ReadString(&key) || !r.Consume(':')) {
+        *error = "Bad key";
+        return false;
+      }
+      bool ok;
+      if (key == "id") {
+        ok = r.ReadString(&req->id);
+      } else if (key == "level") {
+        ok = r.ReadStringArray(&req->rows);
+      } else if (key == "max_nodes") {
+        ok = r.ReadNumber(&req->max_nodes);
+      } else if (key == "time_ms") {
+        ok = r.ReadNumber(&req->time_ms);
+      } else if (key == "stats") {
+        ok = r.ReadBool(&req->stats);
+      } else {
+        ok = r.SkipValue();
+      }
+      if (!ok) {
+        *error = "Bad value of " + key;
+        return false;
+      }
+    } while (r.Consume(','));
+    if (!r.Consume('}')) {
+      *error = "Missing }";
+      return false;
+    }
+  }
+  if (!r.AtEnd()) {
+    *error = "Trailing characters";
+    return false;
+  }
+  if (req->rows.empty()) {
+    *error = "Empty level";
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Solving
+////////////////////////////////////////////////////////////////////////////////
+
+static string ErrorAnswer(const string& id, const string& error) {
+  return "{\"id\": \"" + JsonEscape(id) + "\", \"status\": \"error\", " +
+         "\"error\": \"" + JsonEscape(error) + "\"}";
+}
+
+template <class G>
+static string SolveOnGeometry(const SolveRequest& req, const Level& level) {
+  char bc[G::BOARD_SIZE + 1];
+  const int num_tiles = LevelToBoard<G>(level, bc);
+  bc[G::BOARD_SIZE] = 0;
+  // State exits on these.
+  if (num_tiles > G::MAX_TILES) return ErrorAnswer(req.id, "Too many tiles");
+  BasicBoard<G> b(bc, REAL_RULES);
+  BasicState<G> s(bc);
+  SolveOptions options;
+  options.max_nodes = req.max_nodes;
+  options.collect_stats = req.stats;
+  const long long start = NowMicros();
+  if (req.time_ms > 0) options.deadline_us = start + req.time_ms * 1000;
+  const BasicSolveResult<G> res = solve(b, s, options);
+  const long long ms = (NowMicros() - start) / 1000;
+
+  stringstream ss;
+  ss << "{\"id\": \"" << JsonEscape(req.id) << "\", \"status\": \""
+     << SolveStatusName(res.status) << "\"";
+  if (res.success) {
+    ss << ", \"length\": " << res.end_state.GetHistoryLen()
+       << ", \"solution\": \""
+       << JsonEscape(ReplaySolution(b, s, res.end_state.GetHistory(),
+                                    res.end_state.GetHistoryLen()))
+       << "\"";
+  } else {
+    ss << ", \"lower_bound\": " << res.lower_bound;
+  }
+  ss << ", \"visited\": " << res.num_visited_states << ", \"ms\": " << ms;
+  if (req.stats) ss << ", \"stats\": " << res.stats.ToJson();
+  ss << "}";
+  return ss.str();
+}
+
+string HandleRequest(const string& line) {
+  SolveRequest req;
+  string error;
+  if (!ParseRequest(line, &req, &error)) return ErrorAnswer(req.id, error);
+  Level level;
+  for (size_t i = 0; i < req.rows.size(); ++i) {
+    if (!AddLevelRow(req.rows[i], &level, &error)) {
+      return ErrorAnswer(req.id, error);
+    }
+  }
+  const int height = level.size();
+  const int width = level[0].size();
+#define TRY_GEOMETRY(G)                                       \
+  if (width + 2 <= G::BOARD_X && height + 2 <= G::BOARD_Y) {  \
+    return SolveOnGeometry<G>(req, level);                    \
+  }
+  GTN_FOR_EACH_GEOMETRY(TRY_GEOMETRY)
+#undef TRY_GEOMETRY
+  return ErrorAnswer(req.id, "Level too big");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SolveServer
+////////////////////////////////////////////////////////////////////////////////
+
+SolveServer::SolveServer(int num_workers) : stopping(false) {
+  for (int i = 0; i < num_workers; ++i) {
+    workers.push_back(thread(&SolveServer::Work, this));
+  }
+}
+
+SolveServer::~SolveServer() {
+  {
+    lock_guard<mutex> lock(mu);
+    stopping = true;
+  }
+  cv.notify_all();
+  for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+}
+
+void SolveServer::Submit(const string& line, const Callback& done) {
+  {
+    lock_guard<mutex> lock(mu);
+    queue.push_back(make_pair(line, done));
+  }
+  cv.notify_one();
+}
+
+void SolveServer::Work() {
+  while (true) {
+    pair<string, Callback> request;
+    {
+      unique_lock<mutex> lock(mu);
+      while (queue.empty() && !stopping) cv.wait(lock);
+      if (queue.empty()) return;
+      request = queue.front();
+      queue.pop_front();
+    }
+    request.second(HandleRequest(request.first));
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Streams and sockets
+////////////////////////////////////////////////////////////////////////////////
+
+static bool WriteAll(int fd, const string& s) {
+  size_t done = 0;
+  while (done < s.size()) {
+    const ssize_t n = write(fd, s.data() + done, s.size() - done);
+    if (n <= 0) return false;
+    done += n;
+  }
+  return true;
+}
+
+// Calls line for every line read from fd until its end.
+static void ReadLines(int fd, const function<void(const string&)>& line) {
+  string buffer;
+  char chunk[4096];
+  while (true) {
+    const ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n <= 0) break;
+    buffer.append(chunk, n);
+    size_t start = 0;
+    size_t end;
+    while ((end = buffer.find('\n', start)) != string::npos) {
+      line(buffer.substr(start, end - start));
+      start = end + 1;
+    }
+    buffer.erase(0, start);
+  }
+  if (!buffer.empty()) line(buffer);
+}
+
+void ServeStream(int in_fd, int out_fd, SolveServer* server) {
+  mutex mu;
+  condition_variable cv;
+  int pending = 0;
+  ReadLines(in_fd, [&](const string& line) {
+    if (line.find_first_not_of(" \t\r") == string::npos) return;
+    {
+      lock_guard<mutex> lock(mu);
+      ++pending;
+    }
+    server->Submit(line, [&, out_fd](const string& answer) {
+      lock_guard<mutex> lock(mu);
+      WriteAll(out_fd, answer + "\n");
+      --pending;
+      cv.notify_all();
+    });
+  });
+  unique_lock<mutex> lock(mu);
+  while (pending > 0) cv.wait(lock);
+}
+
+bool ServeUnixSocket(const string& path, SolveServer* server,
+                     int max_connections) {
+  sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path)) return false;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  unlink(path.c_str());
+  if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+    close(fd);
+    return false;
+  }
+  vector<thread> connections;
+  for (int n = 0; max_connections == 0 || n < max_connections; ++n) {
+    const int conn = accept(fd, NULL, NULL);
+    if (conn < 0) continue;
+    thread t([conn, server]() {
+      ServeStream(conn, conn, server);
+      close(conn);
+    });
+    if (max_connections == 0) {
+      t.detach();
+    } else {
+      connections.push_back(move(t));
+    }
+  }
+  for (size_t i = 0; i < connections.size(); ++i) connections[i].join();
+  close(fd);
+  unlink(path.c_str());
+  return true;
+}
+
+bool SendRequests(const string& path, const vector<string>& lines,
+                  vector<string>* answers) {
+  sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path)) return false;
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+    close(fd);
+    return false;
+  }
+  // Answers come back while we are still sending.
+  thread reader([fd, answers]() {
+    ReadLines(fd, [answers](const string& line) {
+      answers->push_back(line);
+    });
+  });
+  bool ok = true;
+  for (size_t i = 0; i < lines.size() && ok; ++i) {
+    ok = WriteAll(fd, lines[i] + "\n");
+  }
+  shutdown(fd, SHUT_WR);
+  reader.join();
+  close(fd);
+  return ok;
+}
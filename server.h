@@ -0,0 +1,82 @@
+#ifndef _GTN_SERVER_H__
+#define _GTN_SERVER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Solver service speaking JSON lines. A request is an object on one line:
+//   {"id": "p1l01", "level": ["TRE_A1,------,...", ...],
+//    "max_nodes": 100000, "time_ms": 500, "stats": true}
+// The rows of level are the lines of a levels/ file. max_nodes and time_ms
+// are optional limits of the solve, stats adds the SearchStats of the solve
+// to the answer. The answer is an object on one line too:
+//   {"id": "p1l01", "status": "solved", "length": 4,
+//    "solution": "(3,4)-MSE-U/...", "visited": 11, "ms": 0}
+// status is "error" with an "error" message for bad requests, otherwise
+// SolveStatusName(), with the proven "lower_bound" instead of the solution
+// when there is none: no solution is shorter. It is at most MAX_MOVES, which
+// with "no_solution" means none within MAX_MOVES.
+
+struct SolveRequest {
+  SolveRequest() : max_nodes(0), time_ms(0), stats(false) {}
+  std::string id;
+  std::vector<std::string> rows;
+  long long max_nodes;
+  long long time_ms;
+  bool stats;
+};
+
+// Returns false with error set if line is not a request.
+bool ParseRequest(const std::string& line, SolveRequest* req,
+                  std::string* error);
+
+// Solves the request on line and returns the answer, without a newline.
+std::string HandleRequest(const std::string& line);
+
+// A pool of threads solving requests.
+class SolveServer {
+ public:
+  typedef std::function<void(const std::string&)> Callback;
+
+  explicit SolveServer(int num_workers);
+  // Finishes the queued requests.
+  ~SolveServer();
+
+  // Queues the request line, done gets the answer on a worker thread.
+  void Submit(const std::string& line, const Callback& done);
+
+ private:
+  void Work();
+
+  std::mutex mu;
+  std::condition_variable cv;
+  std::deque<std::pair<std::string, Callback> > queue;
+  bool stopping;
+  std::vector<std::thread> workers;
+
+  // Not copyable.
+  SolveServer(const SolveServer&);
+  void operator=(const SolveServer&);
+};
+
+// Reads request lines from in_fd until its end and writes each answer to
+// out_fd as soon as it is ready. Returns when every answer is written.
+void ServeStream(int in_fd, int out_fd, SolveServer* server);
+
+// Serves every connection to a Unix domain socket at path with ServeStream().
+// Returns after max_connections connections, never if it is 0, or false if
+// the socket can't be set up.
+bool ServeUnixSocket(const std::string& path, SolveServer* server,
+                     int max_connections = 0);
+
+// Client side: sends lines to the server at path and collects the answers.
+bool SendRequests(const std::string& path,
+                  const std::vector<std::string>& lines,
+                  std::vector<std::string>* answers);
+
+#endif // _GTN_SERVER_H__
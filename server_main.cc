@@ -0,0 +1,45 @@
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "server.h"
+#include "solve.h"
+
+using namespace std;
+
+static void DumpProgress(int) {
+  RequestProgressDump();
+}
+
+// solve_server [-j workers] [socket]
+// Serves JSON line requests, see server.h, on the Unix domain socket or on
+// stdin and stdout if none is given. SIGUSR1 prints the progress of the
+// running solves to stderr.
+int main(int argc, char **argv) {
+  int num_workers = thread::hardware_concurrency();
+  string socket_path;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      num_workers = atoi(argv[++i]);
+    } else {
+      socket_path = argv[i];
+    }
+  }
+  if (num_workers < 1) num_workers = 1;
+  // A client going away must not take the server with it.
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGUSR1, DumpProgress);
+  SolveServer server(num_workers);
+  if (socket_path.empty()) {
+    ServeStream(0, 1, &server);
+    return 0;
+  }
+  if (!ServeUnixSocket(socket_path, &server)) {
+    cout << "Can't listen on " << socket_path << endl;
+    exit(2);
+  }
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "server.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+// levels/P1L01, solved in 4 moves.
+static const char P1L01[] =
+    "\"level\": ["
+    "\"TRE_A1,------,------,------,------,------,------,ACG_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,------,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,MSE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,------,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,------,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,SQR_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\"]";
+
+// levels/P4L30, needs thousands of states.
+static const char P4L30[] =
+    "\"level\": ["
+    "\"TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,------,------,------,MSE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,------,TRE_A1,SNK_A1,------,------\","
+    "\"TRE_A1,TRE_A1,TRE_A1,------,TRE_A1,------,TRE_A1,TRE_A1\","
+    "\"TRE_A1,------,TRE_A1,------,TRE_A1,TRE_A1,TRE_A1,ACG_A1\","
+    "\"TRE_A1,SQR_A1,------,------,------,PRC_A1,PRC_A1,PRC_A1\"]";
+
+// The squirrel is walled in, the start is dead.
+static const char WALLED_IN[] =
+    "\"level\": ["
+    "\"TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,ACG_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\","
+    "\"SQR_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1,TRE_A1\"]";
+
+TEST(TestServer, ParseRequest) {
+  SolveRequest req;
+  string error;
+  ASSERT_TRUE(ParseRequest(
+      "{\"id\": \"a\\\"b\", \"level\": [\"x,y\", \"z,w\"], "
+      "\"max_nodes\": 12, \"time_ms\": 3.5, \"extra\": null}",
+      &req, &error)) << error;
+  EXPECT_EQ("a\"b", req.id);
+  ASSERT_EQ(2, req.rows.size());
+  EXPECT_EQ("z,w", req.rows[1]);
+  EXPECT_EQ(12, req.max_nodes);
+  EXPECT_EQ(3, req.time_ms);
+  EXPECT_FALSE(ParseRequest("[]", &req, &error));
+  req = SolveRequest();
+  EXPECT_FALSE(ParseRequest("{\"id\": \"x\"}", &req, &error));
+  EXPECT_EQ("Empty level", error);
+  EXPECT_FALSE(ParseRequest("{\"level\": [\"a\"]} x", &req, &error));
+}
+
+TEST(TestServer, HandleRequest) {
+  EXPECT_EQ(0, HandleRequest(string("{\"id\": \"1\", ") + P1L01 + "}")
+               .find("{\"id\": \"1\", \"status\": \"solved\", \"length\": 4, "
+                     "\"solution\": \"(3,4)-MSE-U/(1,4)-MSE-L/(6,4)-SQR-U/"
+                     "(1,4)-SQR-R/\""));
+  EXPECT_NE(string::npos,
+            HandleRequest(string("{\"id\": \"2\", \"max_nodes\": 10, ") +
+                          P4L30 + "}").find("\"node_limit\", \"lower_bound\": "));
+  EXPECT_NE(string::npos,
+            HandleRequest(string("{\"id\": \"6\", ") + WALLED_IN + "}")
+                .find("\"no_solution\", \"lower_bound\": 100, "));
+  EXPECT_NE(string::npos,
+            HandleRequest(string("{\"id\": \"4\", \"stats\": true, ") +
+                          P1L01 + "}").find(", \"stats\": {\"solves\": 1, "));
+  EXPECT_EQ(string::npos,
+            HandleRequest(string("{\"id\": \"5\", \"stats\": false, ") +
+                          P1L01 + "}").find("\"stats\""));
+  EXPECT_EQ("{\"id\": \"3\", \"status\": \"error\", "
+            "\"error\": \"Unknown cell: XYZ\"}",
+            HandleRequest("{\"id\": \"3\", \"level\": [\"XYZ\"]}"));
+  EXPECT_NE(string::npos, HandleRequest("nonsense").find("\"error\""));
+}
+
+TEST(TestServer, UnixSocket) {
+  const string path = "/tmp/gtn_server_test.sock";
+  SolveServer server(2);
+  thread listener([&]() { EXPECT_TRUE(ServeUnixSocket(path, &server, 1)); });
+  // Wait for the socket.
+  for (int i = 0; i < 100 && access(path.c_str(), F_OK) != 0; ++i) {
+    usleep(10000);
+  }
+  vector<string> lines;
+  lines.push_back(string("{\"id\": \"slow\", ") + P4L30 + "}");
+  lines.push_back(string("{\"id\": \"fast\", ") + P1L01 + "}");
+  lines.push_back("{\"id\": \"bad\"}");
+  vector<string> answers;
+  ASSERT_TRUE(SendRequests(path, lines, &answers));
+  listener.join();
+  ASSERT_EQ(3, answers.size());
+  int solved = 0;
+  for (size_t i = 0; i < answers.size(); ++i) {
+    solved += answers[i].find("\"solved\"") != string::npos;
+  }
+  EXPECT_EQ(2, solved);
+  // Streamed as they finish, the slow one can't be first.
+  EXPECT_EQ(string::npos, answers[0].find("slow"));
+}
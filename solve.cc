@@ -1,6 +1,14 @@
 #include <cstdlib>
+#include <stdio.h>
 
 #include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <deque>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <set>
@@ -8,34 +16,55 @@
 
 #include "convert.h"
 #include "log.h"
+#include "rank.h"
 #include "solve.h"
-
-#define STATS true
+#include "utils.h"
+#include "visited.h"
 
 using namespace std;
 
-static const int MOVEABLE[] = {
-  0,  // "ACG";
-  1,  // "SQR";
-  1,  // "HOG";
-  1,  // "MSE";
-  0,  // "ACN";
-  1,  // "WLF";
-  1,  // "BER";
-  0,  // "TPP";
-  1,  // "ALG";
-  0,  // "SWM";
-  0,  // "MSS";
-  0,  // "HOS";
-  1,  // "SNK";
-  1,  // "PRC";
-  0,  // "FSN";
-};
+const char* SolveStatusName(SolveStatus status) {
+  switch (status) {
+    case SOLVED: return "solved";
+    case NO_SOLUTION: return "no_solution";
+    case NODE_LIMIT: return "node_limit";
+    case STATE_LIMIT: return "state_limit";
+    case DEADLINE: return "deadline";
+    case CANCELLED: return "cancelled";
+    case KEY_TOO_WIDE: return "key_too_wide";
+  }
+  return "unknown";
+}
+
+// Visited states per expanded state, about 1.4 in the hard levels, for
+// sizing the visited filter from SolveOptions::max_nodes.
+static const long long VISITED_PER_EXPANDED = 2;
+// Filters for more grow with the visited table instead, 32MB.
+static const long long MAX_FILTER_ENTRIES = 1LL << 24;
 
-typedef std::map<State::HashValue, int, State::CmpByHash> VisitedMap;
+// Bumped by RequestProgressDump(), every solve remembers the last value it
+// printed at.
+static std::atomic<int> progress_dumps(0);
+
+void RequestProgressDump() {
+  progress_dumps.fetch_add(1, std::memory_order_relaxed);
+}
+
+string FormatProgress(const SolveProgress& p) {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "min:%d expanded:%lld (%.0f/s) frontier:%lld visited:%lld "
+           "mem:%lldMB %.1fs",
+           p.min_moves, p.num_expanded, p.nodes_per_sec, p.frontier,
+           p.visited, p.bytes >> 20, p.elapsed_us / 1e6);
+  return buf;
+}
 
-std::string ReplaySolution(const Board& b, const State& start_state,
-                           const State::HistoryItem* history, int history_len) {
+template <class G>
+std::string ReplaySolution(
+    const BasicBoard<G>& b, const BasicState<G>& start_state,
+    const typename BasicState<G>::HistoryItem* history, int history_len) {
+  typedef BasicState<G> State;
   std::stringstream ss;
   State* states = new State[history_len + 1];
   states[0] = start_state;
@@ -44,7 +73,7 @@ std::string ReplaySolution(const Board& b, const State& start_state,
     int pos = moving_tile.pos;
     int type = moving_tile.type;
     std::stringstream move;
-    move << "(" << pos / BOARD_X << "," << pos % BOARD_X << ")-"
+    move << "(" << pos / G::BOARD_X << "," << pos % G::BOARD_X << ")-"
        << CodeToTri('a' + type) << "-"
          << State::DIRNAME[history[i].dir];
     ss << move.str() << "/";
@@ -61,11 +90,68 @@ std::string ReplaySolution(const Board& b, const State& start_state,
   return ss.str();
 }
 
+// Lower bound on the moves to win from state: the squirrel's distance, or
+// what an earlier search learned about the state.
+template <class G, int WORDS>
+static int LowerBound(const BasicBoard<G>& board, const BasicState<G>& state,
+                      const StateKey<WORDS>& key,
+                      const std::map<StateKey<WORDS>, int>* learned) {
+  int h = board.MinMovesFrom(state);
+  if (learned != NULL) {
+    typename std::map<StateKey<WORDS>, int>::const_iterator it =
+        learned->find(key);
+    if (it != learned->end() && it->second > h) h = it->second;
+  }
+  return h;
+}
+
+// Progress of SolveWithKey(). A std::map node costs about 32 bytes besides
+// its value.
+template <class G, int WORDS>
+static SolveProgress MakeProgress(int min_moves, long long num_expanded,
+                                  long long elapsed_us, long long frontier,
+                                  long long visited, long long visited_bytes) {
+  SolveProgress p;
+  p.min_moves = min_moves;
+  p.num_expanded = num_expanded;
+  p.elapsed_us = elapsed_us;
+  p.nodes_per_sec = elapsed_us > 0 ? num_expanded * 1e6 / elapsed_us : 0;
+  p.frontier = frontier;
+  p.visited = visited;
+  p.bytes = frontier * (sizeof(BasicState<G>) + sizeof(StateKey<WORDS>) +
+                        sizeof(void*) + 32) +
+            visited_bytes;
+  return p;
+}
+
+// Out of line to keep the search loop tight.
+static void __attribute__((noinline)) ReportProgress(
+    const SolveOptions& options, bool report, bool dump,
+    const SolveProgress& progress) {
+  if (dump) fprintf(stderr, "%s\n", FormatProgress(progress).c_str());
+  if (report) options.progress(progress);
+}
+
 // Returns whether the puzzle can be solved. Sets the number of moves and the
 // direction of the moves in the output args.
-SolveResult solve(const Board& board, const State& start_state) {
+// learned: if not NULL, lower bounds from earlier searches on the same board.
+// After a successful search it gets the bound L - g for every expanded state,
+// where L is the solution length and g the moves to the state (Adaptive A*).
+template <class G, int WORDS>
+static BasicSolveResult<G> SolveWithKey(
+    const BasicBoard<G>& board, const BasicState<G>& start_state,
+    const SolveOptions& options,
+    std::map<StateKey<WORDS>, int>* learned = NULL) {
+  typedef BasicState<G> State;
+  typedef StateKey<WORDS> Key;
+  // A generated state waiting for its visited check.
+  struct Successor {
+    State* state;
+    Key hash;
+    int min_moves;
+  };
   int ss = 0;  // state_size. How many states we store in memory.
-  SolveResult res;
+  BasicSolveResult<G> res;
   // if (board.IsGoal(start_state)) {
   //   res.end_state = start_state;
   //   res.success = true;
@@ -73,7 +159,9 @@ SolveResult solve(const Board& board, const State& start_state) {
   // }
 
   // state hash -> min_moves
-  VisitedMap visited_states;
+  VisitedTable<WORDS> visited_states(
+      options.huge_pages, options.visited_filter,
+      min(options.max_nodes * VISITED_PER_EXPANDED, MAX_FILTER_ENTRIES));
 
   // Indexed by min_moves. min_moves is: Lower bound on the number of moves
   // needed to solve the puzzle through any states in group. The lower bound is
@@ -81,84 +169,743 @@ SolveResult solve(const Board& board, const State& start_state) {
   // the lower bound on the number of moves needed from the current state to
   // reach the end state. All states in the group have the same lower
   // bound of min_moves.
-  vector<StateGroup> state_groups;
-  int min_moves = board.MinMovesFrom(start_state);
+  vector<BasicStateGroup<G, WORDS> > state_groups;
+  Key start_hash;
+  start_state.Hash(board, &start_hash);
+  int min_moves = LowerBound(board, start_state, start_hash, learned);
   LOG(1) << "min:" << min_moves << " "
          << "num states: " << visited_states.size() << endl;
+  // A dead start has an INFINITY bound, only MAX_MOVES of it is proven.
+  res.lower_bound = min(min_moves, MAX_MOVES);
+  if (min_moves >= MAX_MOVES) return res;
   state_groups.resize(MAX_MOVES);
-  state_groups[min_moves].AddState(new State(start_state));
-  State::HashValue start_hash = new unsigned long long[State::HASH_SIZE];
-  start_state.Hash(start_hash);
-  visited_states.insert(make_pair(start_hash, min_moves));
-  if (STATS) { ++ss; if (ss > res.max_mem_state) res.max_mem_state = ss; }
+  long long num_expanded = 0;
+  SearchStats* stats = options.collect_stats ? &res.stats : NULL;
+  if (stats != NULL) stats->num_solves = 1;
+  const long long start_us = NowMicros();
+  long long next_progress_us = start_us + options.progress_every_us;
+  int seen_dumps = progress_dumps.load(std::memory_order_relaxed);
+  // Keys and moves from the start of the expanded states, for learned.
+  vector<pair<Key, int> > expanded;
+  state_groups[min_moves].AddState(start_hash, new State(start_state));
+  visited_states.Insert(start_hash, min_moves);
+  ++ss;
+  if (ss > res.max_mem_state) res.max_mem_state = ss;
   while(true) {
     while (state_groups[min_moves].Empty()) {
       ++min_moves;
       LOG(1) << "min:" << min_moves << " " << "num states: "
              << visited_states.size() << endl;
+      res.lower_bound = min_moves;
       if (min_moves >= MAX_MOVES) {
         LOG(1) << "num states: " << visited_states.size() << endl;
         return res;
       }
     }
+    // Stop at the limits, checking the clock on the first and then every
+    // 1024th state.
+    ++num_expanded;
+    if (options.max_nodes > 0 && num_expanded > options.max_nodes) {
+      res.status = NODE_LIMIT;
+      return res;
+    }
+    if (options.max_states > 0 && ss > options.max_states) {
+      res.status = STATE_LIMIT;
+      return res;
+    }
+    if (options.deadline_us > 0 && num_expanded % 1024 == 1 &&
+        NowMicros() > options.deadline_us) {
+      res.status = DEADLINE;
+      return res;
+    }
+    if (options.cancel != NULL &&
+        options.cancel->load(std::memory_order_relaxed)) {
+      res.status = CANCELLED;
+      return res;
+    }
+    bool report = false;
+    if (options.progress) {
+      if (options.progress_every_nodes > 0 &&
+          num_expanded % options.progress_every_nodes == 0) {
+        report = true;
+      }
+      if (options.progress_every_us > 0 && num_expanded % 1024 == 1 &&
+          NowMicros() >= next_progress_us) {
+        report = true;
+      }
+    }
+    const int dumps = progress_dumps.load(std::memory_order_relaxed);
+    if (report || dumps != seen_dumps) {
+      const long long now = NowMicros();
+      ReportProgress(options, report, dumps != seen_dumps,
+                     MakeProgress<G, WORDS>(min_moves, num_expanded,
+                                            now - start_us, ss,
+                                            visited_states.size(),
+                                            visited_states.Bytes()));
+      seen_dumps = dumps;
+      if (report) next_progress_us = now + options.progress_every_us;
+    }
     // Handle next state in group.
-    const State* curr_state = state_groups[min_moves].Pop();
+    const State* curr_state;
+    {
+      ScopedPhaseTimer timer(stats, PHASE_POP);
+      curr_state = state_groups[min_moves].Pop();
+    }
+    int num_kept = 0;
     LOG(2) << "curr state : " << min_moves << "\n"
            << board.DebugStringWithState(*curr_state) << endl;
-    if (STATS) { --ss; }
+    --ss;
+    ++res.num_expanded;
     const int history_len = curr_state->GetHistoryLen();
-    for (int tile_index = 0; tile_index < curr_state->NumTiles(); ++tile_index) {
-      if (!MOVEABLE[curr_state->GetTile(tile_index).type]) continue;
+    if (options.on_expand) {
+      vector<pair<int, int> > moves(history_len);
+      for (int i = 0; i < history_len; ++i) {
+        moves[i].first = curr_state->GetHistory()[i].tile_index;
+        moves[i].second = curr_state->GetHistory()[i].dir;
+      }
+      options.on_expand(moves);
+    }
+    if (learned != NULL) {
+      Key curr_hash;
+      curr_state->Hash(board, &curr_hash);
+      expanded.push_back(make_pair(curr_hash, history_len));
+    }
+    // Successors are generated first and their visited slots prefetched, then
+    // checked against visited_states in the same order, which overlaps the
+    // cache misses of the lookups.
+    Successor successors[G::MAX_TILES * 4];
+    int num_successors = 0;
+    State* win_state = NULL;
+    typename State::Cells occupied;
+    curr_state->GetOccupied(&occupied);
+    for (int tile_index = 0;
+         tile_index < curr_state->NumTiles() && win_state == NULL;
+         ++tile_index) {
+      const Tile& tile = curr_state->GetTile(tile_index);
+      if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
       for (int di = 0; di < 4; ++di) {
         // Put it on the heap.
         State* new_state = new State();
-        int move_res = curr_state->Move(board, tile_index, di, new_state);
-        if (STATS) ++res.num_moves;
+        int move_res;
+        int slide_len;
+        {
+          ScopedPhaseTimer timer(stats, PHASE_MOVE);
+          move_res = curr_state->Move(board, tile_index, di, occupied,
+                                      new_state,
+                                      stats != NULL ? &slide_len : NULL);
+        }
+        ++res.num_moves;
+        if (stats != NULL) {
+          ++stats->num_generated;
+          stats->slide_length.Add(slide_len);
+        }
         if (move_res == State::LOSE) {
+          delete new_state;
           continue;
         }
         if (move_res == State::WIN) {
-          res.success = true;
-          res.end_state = *new_state;
+          // The successors before it still go to visited_states.
+          win_state = new_state;
+          break;
+        }
+        bool dead;
+        {
+          ScopedPhaseTimer timer(stats, PHASE_MOVE);
+          dead = board.IsDead(*new_state);
+        }
+        if (dead) {
           delete new_state;
-          delete curr_state;
-          LOG(1) << "num states: " << visited_states.size() << endl;
-          return res;
+          ++res.num_dead_pruned;
+          continue;
         }
-        // Compute min_moves
-        int new_min_moves =
-          history_len + 1 + board.MinMovesFrom(*new_state);
-        LOG(2) << "new min moves:" << new_min_moves << endl;
+        Successor& succ = successors[num_successors];
+        {
+          ScopedPhaseTimer timer(stats, PHASE_HASH);
+          new_state->Hash(board, &succ.hash);
+          // Compute min_moves
+          succ.min_moves = history_len + 1 +
+              LowerBound(board, *new_state, succ.hash, learned);
+        }
+        LOG(2) << "new hash:" << succ.hash.w[0] << endl;
+        LOG(2) << "new min moves:" << succ.min_moves << endl;
         //assert(new_min_moves >= min_moves);
-        // Check if the new state has already been seen.
-        State::HashValue new_hash = new unsigned long long[State::HASH_SIZE];
-        new_state->Hash(new_hash);
-        LOG(2) << "new hash:" << new_hash[0] << new_hash[1] << endl;
-        VisitedMap::iterator it = visited_states.find(new_hash);
-        if (it != visited_states.end()) {
-          // state already visited
-          LOG(2) << "State visited\n";
-          int prev_min_moves = it->second;
-          if (prev_min_moves > new_min_moves) {
-            // found state is in a bigger group, remove from that group.
-            state_groups[prev_min_moves].RemoveState(new_hash);
-            if (STATS) ++res.num_visited_hit_improve;
-            if (STATS) { --ss; }
-          } else {
-            // found state is in a smaller or equal group, drop the new state.
-            delete new_state;
-            if (STATS) ++res.num_visited_hit_drop;
-            continue;
-          }
+        if (succ.min_moves >= MAX_MOVES) {
+          delete new_state;
+          continue;
+        }
+        succ.state = new_state;
+        visited_states.Prefetch(succ.hash);
+        ++num_successors;
+      }
+    }
+    for (int i = 0; i < num_successors; ++i) {
+      State* new_state = successors[i].state;
+      const Key& new_hash = successors[i].hash;
+      const int new_min_moves = successors[i].min_moves;
+      // Check if the new state has already been seen.
+      int prev_min_moves;
+      bool seen;
+      {
+        ScopedPhaseTimer timer(stats, PHASE_VISITED);
+        seen = visited_states.Find(new_hash, &prev_min_moves);
+      }
+      if (seen) {
+        // state already visited
+        LOG(2) << "State visited\n";
+        if (prev_min_moves > new_min_moves) {
+          // found state is in a bigger group, remove from that group.
+          ScopedPhaseTimer timer(stats, PHASE_PUSH);
+          state_groups[prev_min_moves].RemoveState(new_hash);
+          ++res.num_visited_hit_improve;
+          --ss;
+        } else {
+          // found state is in a smaller or equal group, drop the new state.
+          delete new_state;
+          ++res.num_visited_hit_drop;
+          continue;
+        }
+      }
+      LOG(2) << "NEW State with min moves" << new_min_moves << endl;
+      // We need to keep this new state and insert it in its group.
+      {
+        ScopedPhaseTimer timer(stats, PHASE_PUSH);
+        state_groups[new_min_moves].AddState(new_hash, new_state);
+      }
+      ++ss;
+      if (ss > res.max_mem_state) res.max_mem_state = ss;
+      {
+        ScopedPhaseTimer timer(stats, PHASE_VISITED);
+        visited_states.Insert(new_hash, new_min_moves);
+      }
+      ++res.num_visited_states;
+      ++num_kept;
+      if (stats != NULL) stats->f_gap.Add(new_min_moves - min_moves);
+    }
+    if (stats != NULL) {
+      stats->visited_filter_negatives = visited_states.FilterNegatives();
+    }
+    if (win_state != NULL) {
+      res.success = true;
+      res.status = SOLVED;
+      res.end_state = *win_state;
+      res.lower_bound = res.end_state.GetHistoryLen();
+      delete win_state;
+      delete curr_state;
+      if (learned != NULL) {
+        const int len = res.end_state.GetHistoryLen();
+        for (size_t i = 0; i < expanded.size(); ++i) {
+          int& h = (*learned)[expanded[i].first];
+          if (len - expanded[i].second > h) h = len - expanded[i].second;
         }
-        LOG(2) << "NEW State with min moves" << new_min_moves << endl;
-        // We need to keep this new state and insert it in its group.
-        state_groups[new_min_moves].AddState(new_state);
-        if (STATS) { ++ss; if (ss > res.max_mem_state) res.max_mem_state = ss; }
-        visited_states.insert(make_pair(new_hash, new_min_moves));
-        if (STATS) ++res.num_visited_states;
       }
+      LOG(1) << "num states: " << visited_states.size() << endl;
+      return res;
+    }
+    if (stats != NULL) {
+      ++stats->num_expanded;
+      stats->branching.Add(num_kept);
     }
     delete curr_state;
   }
 }
+
+template <class G>
+BasicSolveResult<G> solve(const BasicBoard<G>& board,
+                          const BasicState<G>& start_state,
+                          const SolveOptions& options) {
+  const int words = board.KeyWords(start_state);
+  if (words > MAX_KEY_WORDS) {
+    BasicSolveResult<G> res;
+    res.status = KEY_TOO_WIDE;
+    return res;
+  }
+  const long long lookups = board.SlideCacheLookups();
+  const long long hits = board.SlideCacheHits();
+  BasicSolveResult<G> res;
+  if (words <= 1) {
+    res = SolveWithKey<G, 1>(board, start_state, options);
+  } else if (words <= 2) {
+    res = SolveWithKey<G, 2>(board, start_state, options);
+  } else if (words <= 3) {
+    res = SolveWithKey<G, 3>(board, start_state, options);
+  } else {
+    res = SolveWithKey<G, MAX_KEY_WORDS>(board, start_state, options);
+  }
+  if (options.collect_stats) {
+    res.stats.slide_cache_lookups = board.SlideCacheLookups() - lookups;
+    res.stats.slide_cache_hits = board.SlideCacheHits() - hits;
+  }
+  return res;
+}
+
+template <class G> const size_t BasicSolver<G>::MAX_HINTS;
+template <class G> const size_t BasicSolver<G>::MAX_LEARNED;
+
+template <class G>
+BasicSolver<G>::BasicSolver(const Board& board_)
+  : board(board_), num_searches(0), num_cache_hits(0) {
+  no_hint.distance = -1;
+  no_hint.tile_index = 0;
+  no_hint.dir = 0;
+}
+
+template <class G>
+const typename BasicSolver<G>::Hint& BasicSolver<G>::GetHint(
+    const State& state) {
+  if (board.HashWords(state) > MAX_KEY_WORDS) return no_hint;
+  Key key;
+  state.Hash(board, &key);
+  typename std::map<Key, Hint>::const_iterator it = hints.find(key);
+  if (it != hints.end()) {
+    ++num_cache_hits;
+    return it->second;
+  }
+
+  ++num_searches;
+  if (hints.size() > MAX_HINTS) hints.clear();
+  if (learned.size() > MAX_LEARNED) learned.clear();
+  State start = state;
+  start.ClearHistory();
+  const BasicSolveResult<G> res =
+      SolveWithKey<G, MAX_KEY_WORDS>(board, start, SolveOptions(), &learned);
+  if (!res.success) {
+    Hint& hint = hints[key];
+    hint.distance = -1;
+    return hint;
+  }
+  // Every state on a shortest solution continues with the rest of it.
+  const typename State::HistoryItem* history = res.end_state.GetHistory();
+  const int len = res.end_state.GetHistoryLen();
+  State curr = start;
+  for (int i = 0; i < len; ++i) {
+    Key curr_key;
+    curr.Hash(board, &curr_key);
+    Hint& hint = hints[curr_key];
+    hint.distance = len - i;
+    hint.tile_index = history[i].tile_index;
+    hint.dir = history[i].dir;
+    State next;
+    curr.Move(board, history[i].tile_index, history[i].dir, &next);
+    curr = next;
+  }
+  return hints[key];
+}
+
+template <class G>
+bool BasicSolver<G>::NextMove(const State& state, int* tile_index, int* dir) {
+  const Hint& hint = GetHint(state);
+  if (hint.distance < 0) return false;
+  *tile_index = hint.tile_index;
+  *dir = hint.dir;
+  return true;
+}
+
+template <class G>
+int BasicSolver<G>::Distance(const State& state) {
+  return GetHint(state).distance;
+}
+
+// Tiles of the start state a tablebase file has room for.
+static const int MAX_TABLEBASE_TILES = 32;
+
+// Start of a tablebase file. A ranked table is followed by the entry of each
+// rank, others by num_states keys of key_words words in increasing order, then
+// by the entry of each of them. Entries are the distance, 0 for ranks that
+// are no state and all ones for no win.
+struct TablebaseHeader {
+  char magic[8];
+  int key_words;
+  // 4 or 8.
+  int entry_bits;
+  long long num_states;
+  // Ranks of a ranked table, num_states otherwise.
+  long long num_entries;
+  int ranked;
+  // The start state, the ranker is made from it.
+  int num_start_tiles;
+  unsigned char start_pos[MAX_TABLEBASE_TILES];
+  unsigned char start_type[MAX_TABLEBASE_TILES];
+  // LevelFingerprint() of the board.
+  unsigned long long fingerprint;
+};
+
+static const char TABLEBASE_MAGIC[8] = "GTNTB02";
+
+// Hash of what the states of a level mean on its board: the walls, the
+// relevant cells, the static slots and what each type may turn into.
+template <class G>
+static unsigned long long LevelFingerprint(const BasicBoard<G>& board) {
+  vector<int> layout;
+  layout.push_back(G::BOARD_X);
+  for (int pos = 0; pos < G::BOARD_SIZE; ++pos) {
+    layout.push_back(board.IsOpen(pos) + 2 * board.IsRelevant(pos));
+    layout.push_back(board.StaticSlot(pos));
+  }
+  for (int t = 0; t < NUM_TYPES; ++t) layout.push_back(board.BecomeMask(t));
+  return HashBytes(&layout[0], layout.size() * sizeof(layout[0]));
+}
+
+template <class G, int WORDS>
+static long long BuildTablebaseWithKey(const BasicBoard<G>& board,
+                                       const BasicState<G>& start_state,
+                                       const std::string& path) {
+  static_assert(G::MAX_TILES <= MAX_TABLEBASE_TILES,
+                "The tablebase header can't hold a start state.");
+  typedef BasicState<G> State;
+  typedef StateKey<WORDS> Key;
+  // key -> number of the state in the order it was found.
+  std::map<Key, int> index;
+  std::deque<State> queue;
+
+  State start = start_state;
+  start.ClearHistory();
+  const BasicStateRanker<G> ranker(board, start);
+  const bool ranked = ranker.Valid() && ranker.Size() <= MAX_TABLEBASE_RANKS;
+  // Rank of each state, by number.
+  vector<unsigned long long> ranks;
+  Key start_key;
+  start.Hash(board, &start_key);
+  index.insert(make_pair(start_key, 0));
+  queue.push_back(start);
+
+  // Forward pass: the successors of state i are succ[succ_begin[i]] ..
+  // succ[succ_begin[i + 1] - 1]. Winning moves don't lead to a state.
+  vector<int> succ_begin;
+  vector<int> succ;
+  vector<bool> wins;
+  for (int i = 0; !queue.empty(); ++i) {
+    const State curr = queue.front();
+    queue.pop_front();
+    succ_begin.push_back(succ.size());
+    wins.push_back(false);
+    if (ranked) {
+      ranks.push_back(ranker.Rank(curr));
+      if (ranks.back() >= ranker.Size()) {
+        LOG(1) << "tablebase state outside the rank space" << endl;
+        return -1;
+      }
+    }
+    // Nothing is won from a dead state, no need to look further.
+    if (board.IsDead(curr)) continue;
+    for (int tile_index = 0; tile_index < curr.NumTiles(); ++tile_index) {
+      const Tile& tile = curr.GetTile(tile_index);
+      if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+      for (int di = 0; di < 4; ++di) {
+        State next;
+        int move_res = curr.Move(board, tile_index, di, &next);
+        if (move_res == State::LOSE) continue;
+        if (move_res == State::WIN) {
+          wins[i] = true;
+          continue;
+        }
+        next.ClearHistory();
+        Key key;
+        next.Hash(board, &key);
+        typename std::map<Key, int>::iterator it = index.find(key);
+        if (it == index.end()) {
+          it = index.insert(make_pair(key, (int)index.size())).first;
+          queue.push_back(next);
+        }
+        succ.push_back(it->second);
+      }
+    }
+  }
+  const int num_states = succ_begin.size();
+  succ_begin.push_back(succ.size());
+  LOG(1) << "tablebase states: " << num_states << " edges: " << succ.size()
+         << endl;
+
+  // Predecessor graph, same layout as the successors.
+  vector<int> pred_begin(num_states + 1, 0);
+  for (size_t e = 0; e < succ.size(); ++e) ++pred_begin[succ[e] + 1];
+  for (int i = 0; i < num_states; ++i) pred_begin[i + 1] += pred_begin[i];
+  vector<int> pred(succ.size());
+  {
+    vector<int> fill(pred_begin.begin(), pred_begin.end() - 1);
+    for (int i = 0; i < num_states; ++i) {
+      for (int e = succ_begin[i]; e < succ_begin[i + 1]; ++e) {
+        pred[fill[succ[e]]++] = i;
+      }
+    }
+  }
+
+  // Backward pass: breadth first from the states with a winning move, so each
+  // state gets its distance from the first successor that reaches it.
+  vector<int> dist(num_states, BasicTablebase<G>::NO_WIN);
+  vector<int> order;
+  order.reserve(num_states);
+  for (int i = 0; i < num_states; ++i) {
+    if (wins[i]) {
+      dist[i] = 1;
+      order.push_back(i);
+    }
+  }
+  int max_dist = 0;
+  for (size_t q = 0; q < order.size(); ++q) {
+    const int i = order[q];
+    max_dist = dist[i];
+    for (int e = pred_begin[i]; e < pred_begin[i + 1]; ++e) {
+      if (dist[pred[e]] == BasicTablebase<G>::NO_WIN) {
+        dist[pred[e]] = dist[i] + 1;
+        order.push_back(pred[e]);
+      }
+    }
+  }
+  if (max_dist >= 255) {
+    LOG(1) << "distance to win too large for the tablebase: " << max_dist
+           << endl;
+    return -1;
+  }
+
+  // The highest entry value means no win.
+  TablebaseHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TABLEBASE_MAGIC, sizeof(header.magic));
+  header.key_words = WORDS;
+  header.entry_bits = max_dist < 15 ? 4 : 8;
+  header.num_states = num_states;
+  header.num_entries = ranked ? ranker.Size() : num_states;
+  header.ranked = ranked;
+  header.num_start_tiles = start.NumTiles();
+  for (int i = 0; i < start.NumTiles(); ++i) {
+    header.start_pos[i] = start.GetTile(i).pos;
+    header.start_type[i] = start.GetTile(i).type;
+  }
+  header.fingerprint = LevelFingerprint(board);
+  const int no_win = (1 << header.entry_bits) - 1;
+  vector<unsigned char> entries(
+      (header.num_entries * header.entry_bits + 7) / 8, 0);
+  std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+  out.write((const char*)&header, sizeof(header));
+  long long key_rank = 0;
+  for (typename std::map<Key, int>::const_iterator it = index.begin();
+       it != index.end(); ++it, ++key_rank) {
+    if (!ranked) out.write((const char*)it->first.w, sizeof(it->first.w));
+    const long long e = ranked ? (long long)ranks[it->second] : key_rank;
+    const int d = dist[it->second];
+    const int value = d == BasicTablebase<G>::NO_WIN ? no_win : d;
+    if (header.entry_bits == 8) {
+      entries[e] = value;
+    } else {
+      entries[e / 2] |= value << (e % 2 * 4);
+    }
+  }
+  out.write((const char*)&entries[0], entries.size());
+  out.close();
+  if (!out) return -1;
+  return num_states;
+}
+
+template <class G>
+long long BuildTablebase(const BasicBoard<G>& board,
+                         const BasicState<G>& start_state,
+                         const std::string& path) {
+  const int words = board.KeyWords(start_state);
+  if (words <= 1) return BuildTablebaseWithKey<G, 1>(board, start_state, path);
+  if (words <= 2) return BuildTablebaseWithKey<G, 2>(board, start_state, path);
+  if (words <= 3) return BuildTablebaseWithKey<G, 3>(board, start_state, path);
+  if (words <= MAX_KEY_WORDS) {
+    return BuildTablebaseWithKey<G, MAX_KEY_WORDS>(board, start_state, path);
+  }
+  return -1;
+}
+
+template <class G> const int BasicTablebase<G>::UNKNOWN;
+template <class G> const int BasicTablebase<G>::NO_WIN;
+
+template <class G>
+BasicTablebase<G>::BasicTablebase()
+  : data(NULL), size(0), key_words(0), entry_bits(0), num_states(0),
+    num_entries(0), fingerprint(0), keys(NULL), entries(NULL),
+    open_board(NULL), checked_board(NULL), ranker(NULL) {}
+
+template <class G>
+BasicTablebase<G>::~BasicTablebase() {
+  Close();
+}
+
+template <class G>
+bool BasicTablebase<G>::Open(const std::string& path, const Board& board) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TablebaseHeader)) {
+    close(fd);
+    return false;
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return false;
+  data = p;
+  size = st.st_size;
+  const TablebaseHeader* header = (const TablebaseHeader*)data;
+  const long long key_bytes =
+      header->ranked ? 0 : header->num_states * header->key_words * 8;
+  bool ok =
+      memcmp(header->magic, TABLEBASE_MAGIC, sizeof(header->magic)) == 0 &&
+      header->key_words >= 1 && header->key_words <= MAX_KEY_WORDS &&
+      (header->entry_bits == 4 || header->entry_bits == 8) &&
+      header->num_states >= 0 &&
+      (header->ranked ? header->num_entries <= (long long)MAX_TABLEBASE_RANKS
+                      : header->num_entries == header->num_states) &&
+      size == (long long)sizeof(TablebaseHeader) + key_bytes +
+              (header->num_entries * header->entry_bits + 7) / 8 &&
+      header->num_start_tiles >= 0 &&
+      header->num_start_tiles <= G::MAX_TILES &&
+      header->fingerprint == LevelFingerprint(board);
+  for (int i = 0; ok && i < header->num_start_tiles; ++i) {
+    ok = header->start_pos[i] < G::BOARD_SIZE &&
+         header->start_type[i] < NUM_TYPES;
+  }
+  if (!ok) {
+    Close();
+    return false;
+  }
+  key_words = header->key_words;
+  entry_bits = header->entry_bits;
+  num_states = header->num_states;
+  num_entries = header->num_entries;
+  fingerprint = header->fingerprint;
+  keys = header->ranked ? NULL : (const unsigned long long*)(header + 1);
+  entries = (const unsigned char*)(header + 1) + key_bytes;
+  open_board = &board;
+  if (header->ranked) {
+    char bc[G::BOARD_SIZE + 1];
+    memset(bc, ' ', G::BOARD_SIZE);
+    bc[G::BOARD_SIZE] = 0;
+    for (int i = 0; i < header->num_start_tiles; ++i) {
+      bc[header->start_pos[i]] = 'a' + header->start_type[i];
+    }
+    ranker = new BasicStateRanker<G>(board, State(bc));
+    if (!ranker->Valid() || ranker->Size() != (unsigned long long)num_entries) {
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class G>
+void BasicTablebase<G>::Close() {
+  if (data != NULL) munmap(data, size);
+  data = NULL;
+  size = 0;
+  num_states = 0;
+  num_entries = 0;
+  fingerprint = 0;
+  keys = NULL;
+  entries = NULL;
+  open_board = NULL;
+  checked_board = NULL;
+  delete ranker;
+  ranker = NULL;
+}
+
+template <class G>
+long long BasicTablebase<G>::KeyRank(const unsigned long long* key) const {
+  long long lo = 0;
+  long long hi = num_states;
+  while (lo < hi) {
+    const long long mid = lo + (hi - lo) / 2;
+    const unsigned long long* k = keys + mid * key_words;
+    int cmp = 0;
+    for (int i = 0; i < key_words && cmp == 0; ++i) {
+      if (k[i] != key[i]) cmp = k[i] < key[i] ? -1 : 1;
+    }
+    if (cmp == 0) return mid;
+    if (cmp < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return -1;
+}
+
+template <class G>
+long long BasicTablebase<G>::Index(const Board& board,
+                                   const State& state) const {
+  if (data == NULL) return -1;
+  if (&board != open_board && &board != checked_board) {
+    if (LevelFingerprint(board) != fingerprint) return -1;
+    checked_board = &board;
+  }
+  // No state of the table needs more words, and Hash() fills key_words.
+  if (board.HashWords(state) > key_words) return -1;
+  if (ranker != NULL) {
+    const unsigned long long rank = ranker->Rank(state);
+    return rank < (unsigned long long)num_entries ? (long long)rank : -1;
+  }
+  unsigned long long key[MAX_KEY_WORDS];
+  state.Hash(board, key, key_words);
+  return KeyRank(key);
+}
+
+template <class G>
+int BasicTablebase<G>::Entry(long long index) const {
+  if (entry_bits == 8) return entries[index];
+  return (entries[index / 2] >> (index % 2 * 4)) & 15;
+}
+
+template <class G>
+int BasicTablebase<G>::MaxDistance() const {
+  const int no_win = (1 << entry_bits) - 1;
+  int max_dist = 0;
+  for (long long index = 0; index < num_entries; ++index) {
+    const int value = Entry(index);
+    if (value != no_win && value > max_dist) max_dist = value;
+  }
+  return max_dist;
+}
+
+template <class G>
+int BasicTablebase<G>::Distance(const Board& board,
+                                const State& state) const {
+  const long long index = Index(board, state);
+  if (index < 0) return UNKNOWN;
+  const int value = Entry(index);
+  if (value == 0) return UNKNOWN;
+  return value == (1 << entry_bits) - 1 ? NO_WIN : value;
+}
+
+template <class G>
+bool BasicTablebase<G>::BestMove(const Board& board, const State& state,
+                                 int* tile_index, int* dir) const {
+  const int dist = Distance(board, state);
+  if (dist <= 0) return false;
+  // The table doesn't care about the history, make room for one more move.
+  State curr = state;
+  curr.ClearHistory();
+  for (int ti = 0; ti < curr.NumTiles(); ++ti) {
+    const Tile& tile = curr.GetTile(ti);
+    if (!MOVEABLE[tile.type] || !board.IsRelevant(tile.pos)) continue;
+    for (int di = 0; di < 4; ++di) {
+      State next;
+      int move_res = curr.Move(board, ti, di, &next);
+      if (move_res == State::LOSE) continue;
+      if ((move_res == State::WIN && dist == 1) ||
+          (move_res != State::WIN && Distance(board, next) == dist - 1)) {
+        *tile_index = ti;
+        *dir = di;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+#define INSTANTIATE(G)                                                   \
+  template std::string ReplaySolution<G>(                                \
+      const BasicBoard<G>&, const BasicState<G>&,                        \
+      const BasicState<G>::HistoryItem*, int);                           \
+  template BasicSolveResult<G> solve<G>(const BasicBoard<G>&,            \
+                                        const BasicState<G>&,            \
+                                        const SolveOptions&);            \
+  template class BasicSolver<G>;                                         \
+  template long long BuildTablebase<G>(const BasicBoard<G>&,             \
+                                       const BasicState<G>&,             \
+                                       const std::string&);              \
+  template class BasicTablebase<G>;
+GTN_FOR_EACH_GEOMETRY(INSTANTIATE)
+#undef INSTANTIATE
@@ -1,30 +1,36 @@
 #ifndef _GTN_SOLVE_H__
 #define _GTN_SOLVE_H__
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "board.h"
+#include "stats.h"
 
 static const int MAX_MOVES = 100;
 
-typedef std::map<State::HashValue, const State*, State::CmpByHash> StateMap;
-
-// Represents a group of state candidates that are equally good.
-class StateGroup {
+// Represents a group of state candidates that are equally good. States are
+// keyed by their StateKey<WORDS>.
+template <class G, int WORDS>
+class BasicStateGroup {
  public:
-  ~StateGroup() {
-    for (StateMap::iterator it = states.begin();
+  typedef BasicState<G> State;
+  typedef StateKey<WORDS> Key;
+  typedef std::map<Key, const State*> StateMap;
+
+  ~BasicStateGroup() {
+    for (typename StateMap::iterator it = states.begin();
          it != states.end(); ++it) {
       delete it->second;
     }
   }
 
-  void AddState(const State* state) { 
-    State::HashValue hash = new unsigned long long[State::HASH_SIZE];
-    state->Hash(hash);
-    states[hash] = state; 
+  void AddState(const Key& key, const State* state) {
+    states[key] = state;
   }
 
   // Releases ownership. Assumes non-empty.
@@ -34,8 +40,8 @@ class StateGroup {
     return s;
   }
 
-  void RemoveState(State::HashValue key) {
-    StateMap::iterator it = states.find(key);
+  void RemoveState(const Key& key) {
+    typename StateMap::iterator it = states.find(key);
     if (it != states.end()) {
       delete it->second;
       states.erase(it);
@@ -51,30 +57,264 @@ class StateGroup {
   StateMap states;
 };
 
-struct SolveResult {
-  SolveResult() :
+// Snapshot of a running solve.
+struct SolveProgress {
+  // The f value being expanded.
+  int min_moves;
+  long long num_expanded;
+  long long elapsed_us;
+  double nodes_per_sec;
+  // States waiting to be expanded and states seen.
+  long long frontier;
+  long long visited;
+  // Rough memory use of both.
+  long long bytes;
+};
+
+// One line, as printed on RequestProgressDump().
+std::string FormatProgress(const SolveProgress& progress);
+
+// Makes every running solve print its progress to stderr at its next state.
+// Async signal safe, for a SIGUSR1 handler.
+void RequestProgressDump();
+
+// Limits of a single solve, 0 means no limit.
+struct SolveOptions {
+  SolveOptions()
+    : max_nodes(0), max_states(0), deadline_us(0), cancel(NULL),
+      progress_every_nodes(0), progress_every_us(0), collect_stats(false),
+      huge_pages(false), visited_filter(false) {}
+  // Expanded states.
+  long long max_nodes;
+  // States waiting to be expanded, as counted by max_mem_state.
+  long long max_states;
+  // On the NowMicros() clock.
+  long long deadline_us;
+  // Stops the search when another thread sets it.
+  const std::atomic<bool>* cancel;
+  // Called on the solving thread every progress_every_nodes expanded states
+  // and every progress_every_us microseconds, whichever are set. The clock
+  // is read every 1024 states.
+  std::function<void(const SolveProgress&)> progress;
+  long long progress_every_nodes;
+  long long progress_every_us;
+  // Fills BasicSolveResult::stats.
+  bool collect_stats;
+  // Called with every expanded state as the moves from the start that reach
+  // it, each the tile index and the direction. For recording traces.
+  std::function<void(const std::vector<std::pair<int, int> >&)> on_expand;
+  // Backs the visited states with huge pages where the system has them, see
+  // PageBuffer.
+  bool huge_pages;
+  // Puts a Bloom filter in front of the visited states, see VisitedTable.
+  // It is sized from max_nodes when that is set.
+  bool visited_filter;
+};
+
+// Why a solve stopped.
+enum SolveStatus {
+  SOLVED,
+  // Every state within MAX_MOVES was tried.
+  NO_SOLUTION,
+  // Stopped by a limit of SolveOptions.
+  NODE_LIMIT,
+  STATE_LIMIT,
+  DEADLINE,
+  CANCELLED,
+  // The level needs a key wider than MAX_KEY_WORDS, see Board::KeyWords().
+  KEY_TOO_WIDE,
+};
+
+// "solved", "no_solution", "node_limit" and so on.
+const char* SolveStatusName(SolveStatus status);
+
+template <class G>
+struct BasicSolveResult {
+  BasicSolveResult() :
     success(false),
+    status(NO_SOLUTION),
+    lower_bound(0),
     num_moves(0),
+    num_expanded(0),
     num_visited_states(0),
     num_visited_hit_improve(0),
     num_visited_hit_drop(0),
+    num_dead_pruned(0),
     max_mem_state(0) {}
   bool success;
-  State end_state;
+  SolveStatus status;
+  // Proven minimum solution length: the length of the solution if there is
+  // one, otherwise the lowest f value left unexpanded. MAX_MOVES when there
+  // is no solution within MAX_MOVES.
+  int lower_bound;
+  BasicState<G> end_state;
   // Stats.
   int num_moves;
+  int num_expanded;
   int num_visited_states;
   int num_visited_hit_improve;
   int num_visited_hit_drop;
+  // Successors dropped by BasicBoard::IsDead().
+  int num_dead_pruned;
   int max_mem_state;
+  // With SolveOptions::collect_stats.
+  SearchStats stats;
 };
 
+typedef BasicSolveResult<StandardGeometry> SolveResult;
+
 // Replays the solution and retuns a human readable string about it.
-std::string ReplaySolution(const Board& b, const State& start_state,
-                           const State::HistoryItem* history, int history_len);
+template <class G>
+std::string ReplaySolution(
+    const BasicBoard<G>& b, const BasicState<G>& start_state,
+    const typename BasicState<G>::HistoryItem* history, int history_len);
 
-// Returns whether the puzzle can be solved.
-SolveResult solve(const Board& board, const State& start_state);
+// Returns whether the puzzle can be solved. The visited states and the open
+// list use the narrowest key the level fits into, up to MAX_KEY_WORDS.
+template <class G>
+BasicSolveResult<G> solve(const BasicBoard<G>& board,
+                          const BasicState<G>& start_state,
+                          const SolveOptions& options = SolveOptions());
 
-#endif // _GTN_SOLVE_H__
+// Answers "which move next?" for the states of one level, e.g. after every
+// move of a game in progress. Each solution found is remembered state by
+// state, so following the hints costs one lookup per move. When the player
+// goes their own way the next search starts from the lower bounds the earlier
+// ones proved for the states they expanded.
+template <class G>
+class BasicSolver {
+ public:
+  typedef BasicBoard<G> Board;
+  typedef BasicState<G> State;
+
+  explicit BasicSolver(const Board& board);
+
+  // The first move of a shortest win from state. Returns false if there is
+  // none within MAX_MOVES, or state needs a key wider than MAX_KEY_WORDS.
+  bool NextMove(const State& state, int* tile_index, int* dir);
+  // Moves needed to win from state, -1 if it can't be won or is too wide.
+  int Distance(const State& state);
+
+  // Stats.
+  int NumSearches() const { return num_searches; }
+  int NumCacheHits() const { return num_cache_hits; }
+  int NumLearned() const { return learned.size(); }
+
+  // Past these sizes hints and learned are dropped before the next search,
+  // they only save searches. About 5MB and 75MB.
+  static const size_t MAX_HINTS = 1 << 16;
+  static const size_t MAX_LEARNED = 1 << 20;
+
+ private:
+  typedef StateKey<MAX_KEY_WORDS> Key;
+  // A state on a known shortest solution.
+  struct Hint {
+    int distance;  // -1 if there is no solution.
+    int tile_index;
+    int dir;
+  };
 
+  // Finds the hint of state, searching if it isn't known yet.
+  const Hint& GetHint(const State& state);
+
+  const Board& board;
+  std::map<Key, Hint> hints;
+  // The hint of states too wide to search.
+  Hint no_hint;
+  // Lower bounds on the moves to win proved by the searches so far.
+  std::map<Key, int> learned;
+  int num_searches;
+  int num_cache_hits;
+};
+
+typedef BasicSolver<StandardGeometry> Solver;
+
+// Enumerates every state reachable from start and writes the exact number of
+// moves to win from each of them to path, see BasicTablebase. Returns the
+// number of states, or -1 if the level needs a key wider than MAX_KEY_WORDS,
+// a state has no rank, a distance doesn't fit in a byte or the file can't be
+// written.
+template <class G>
+long long BuildTablebase(const BasicBoard<G>& board,
+                         const BasicState<G>& start_state,
+                         const std::string& path);
+
+// Largest rank space a tablebase is indexed by, 512MB of nibbles.
+static const unsigned long long MAX_TABLEBASE_RANKS = 1ULL << 30;
+
+// Read only view of a file written by BuildTablebase(). The distances take a
+// nibble per state when they all fit, a byte otherwise, and are indexed by
+// the BasicStateRanker rank of the state, so a lookup is one read. Levels
+// whose rank space the ranker can't number, or that is larger than
+// MAX_TABLEBASE_RANKS, store the keys of their states in increasing order
+// instead, and a lookup is a binary search of them. The file is memory
+// mapped, so opening is cheap and pages are only read when looked up.
+template <class G>
+class BasicTablebase {
+ public:
+  typedef BasicBoard<G> Board;
+  typedef BasicState<G> State;
+
+  // Returned by Distance() for states not in the table.
+  static const int UNKNOWN = -1;
+  // Returned by Distance() for states the golden acorn can't be reached from.
+  static const int NO_WIN = -2;
+
+  BasicTablebase();
+  ~BasicTablebase();
+
+  // Maps the table at path, built for the level of board, which must outlive
+  // the open table. Returns false if it is missing, broken or of another
+  // level.
+  bool Open(const std::string& path, const Board& board);
+  void Close();
+
+  long long NumStates() const { return num_states; }
+  // Whether states are looked up by rank rather than by key.
+  bool Ranked() const { return ranker != NULL; }
+  // The largest distance in the table.
+  int MaxDistance() const;
+
+  // Moves needed to win from state. UNKNOWN if board isn't of the level the
+  // table was built for or state isn't one of its states. A board found to be
+  // of the level is remembered, it must not be replaced by another at the
+  // same address while the table is open.
+  int Distance(const Board& board, const State& state) const;
+
+  // The first move of a shortest win from state. Returns false if there is
+  // none.
+  bool BestMove(const Board& board, const State& state,
+                int* tile_index, int* dir) const;
+
+ private:
+  // Index of the entry of state, -1 if it has none.
+  long long Index(const Board& board, const State& state) const;
+  // Rank of key among the table's keys, -1 if missing.
+  long long KeyRank(const unsigned long long* key) const;
+  int Entry(long long index) const;
+
+  void* data;
+  long long size;
+  int key_words;
+  int entry_bits;
+  long long num_states;
+  long long num_entries;
+  unsigned long long fingerprint;
+  // Without a ranker the sorted keys.
+  const unsigned long long* keys;
+  const unsigned char* entries;
+  // The board passed to Open(), whose fingerprint is known to match.
+  const Board* open_board;
+  // The last other board whose fingerprint matched, so a search with its own
+  // copy of the board doesn't fingerprint it on every lookup.
+  mutable const Board* checked_board;
+  BasicStateRanker<G>* ranker;
+
+  // Not copyable, owns the mapping.
+  BasicTablebase(const BasicTablebase&);
+  void operator=(const BasicTablebase&);
+};
+
+typedef BasicTablebase<StandardGeometry> Tablebase;
+
+#endif // _GTN_SOLVE_H__
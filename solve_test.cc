@@ -1,12 +1,15 @@
 #include <iostream>
 #include <sstream>
 #include <set>
+#include <vector>
+#include <unistd.h>
 
 #include "board.h"
 #include "convert.h"
 #include "log.h"
 #include "rules.h"
 #include "solve.h"
+#include "utils.h"
 
 #include "gtest/gtest.h"
 
@@ -27,6 +30,10 @@ void CheckSolution(const char* bs, const string& exp_sol) {
                                          res.end_state.GetHistory(),
                                          num_moves);
   EXPECT_EQ(!exp_sol.empty(), success);
+  EXPECT_EQ(success ? SOLVED : NO_SOLUTION, res.status);
+  if (success) {
+    EXPECT_EQ(num_moves, res.lower_bound);
+  }
   EXPECT_EQ(count(exp_sol.begin(), exp_sol.end(), '/'), num_moves);
   EXPECT_EQ(exp_sol, sol);
 }
@@ -59,3 +66,262 @@ TEST(TestSolve, Solve) {
                 "(6,8)-SQR-U/"
                 "(1,8)-SQR-L/");
 }
+
+TEST(TestSolve, ManyTiles) {
+  Board b(B006, REAL_RULES);
+  State s(B006);
+  EXPECT_EQ(16, s.NumTiles());
+  EXPECT_EQ(3, b.KeyWords(s));
+  CheckSolution(B006,
+                "(4,1)-MSE-D/"
+                "(2,1)-MSE-D/"
+                "(3,4)-SQR-L/"
+                "(3,1)-SQR-U/");
+}
+
+TEST(TestSolve, DeadStatesPruned) {
+  const char B[] =
+    "##########"
+    "#a       #"
+    "####j#####"
+    "#        #"
+    "#   b    #"
+    "#        #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  const SolveResult res = solve(b, s);
+  EXPECT_FALSE(res.success);
+  EXPECT_EQ(NO_SOLUTION, res.status);
+  EXPECT_LT(0, res.num_dead_pruned);
+  EXPECT_EQ(0, res.num_visited_states);
+}
+
+// Solves B003, 6 moves, with options and checks why it stopped.
+void CheckLimit(const SolveOptions& options, SolveStatus exp_status) {
+  const SolveResult res = solve(Board(B003, REAL_RULES), State(B003), options);
+  EXPECT_FALSE(res.success);
+  EXPECT_EQ(exp_status, res.status);
+  EXPECT_LT(0, res.lower_bound);
+  EXPECT_GE(6, res.lower_bound);
+}
+
+TEST(TestSolve, Limits) {
+  SolveOptions options;
+  options.max_nodes = 2;
+  CheckLimit(options, NODE_LIMIT);
+  options = SolveOptions();
+  options.max_states = 1;
+  CheckLimit(options, STATE_LIMIT);
+  options = SolveOptions();
+  options.deadline_us = NowMicros() - 1;
+  CheckLimit(options, DEADLINE);
+  options = SolveOptions();
+  std::atomic<bool> cancel(true);
+  options.cancel = &cancel;
+  CheckLimit(options, CANCELLED);
+  // Loose limits don't change the solution.
+  cancel = false;
+  options.max_nodes = 1000000;
+  options.max_states = 1000000;
+  options.deadline_us = NowMicros() + 60 * 1000000LL;
+  const SolveResult res = solve(Board(B003, REAL_RULES), State(B003), options);
+  EXPECT_EQ(SOLVED, res.status);
+  EXPECT_EQ(6, res.lower_bound);
+  EXPECT_STREQ("state_limit", SolveStatusName(STATE_LIMIT));
+  EXPECT_STREQ("key_too_wide", SolveStatusName(KEY_TOO_WIDE));
+}
+
+TEST(TestSolve, CollectStats) {
+  const SolveResult plain = solve(Board(B003, REAL_RULES), State(B003));
+  EXPECT_EQ(0, plain.stats.num_solves);
+  EXPECT_EQ(0, plain.stats.phase_calls[PHASE_MOVE]);
+  SolveOptions options;
+  options.collect_stats = true;
+  const SolveResult res = solve(Board(B003, REAL_RULES), State(B003), options);
+  ASSERT_TRUE(res.success);
+  const SearchStats& stats = res.stats;
+  EXPECT_EQ(1, stats.num_solves);
+  EXPECT_EQ(res.num_moves, stats.num_generated);
+  EXPECT_EQ(res.num_moves, stats.slide_length.Count());
+  EXPECT_LT(0, stats.num_expanded);
+  // The expansion that wins is cut short.
+  EXPECT_EQ(stats.num_expanded, stats.branching.Count());
+  EXPECT_EQ(stats.num_expanded + 1, stats.phase_calls[PHASE_POP]);
+  // Every kept state is pushed.
+  EXPECT_EQ(res.num_visited_states, stats.f_gap.Count());
+  EXPECT_LE(res.num_visited_states, stats.phase_calls[PHASE_PUSH]);
+  EXPECT_LT(0, stats.phase_calls[PHASE_HASH]);
+  EXPECT_LT(0, stats.phase_calls[PHASE_VISITED]);
+  // The same search as without stats.
+  EXPECT_EQ(plain.num_moves, res.num_moves);
+  EXPECT_EQ(plain.num_visited_states, res.num_visited_states);
+}
+
+TEST(TestSolve, VisitedFilter) {
+  const SolveResult plain = solve(Board(B003, REAL_RULES), State(B003));
+  SolveOptions options;
+  options.collect_stats = true;
+  options.visited_filter = true;
+  const SolveResult res = solve(Board(B003, REAL_RULES), State(B003), options);
+  ASSERT_TRUE(res.success);
+  // The filter only skips lookups, the search is the same.
+  EXPECT_EQ(plain.end_state.GetHistoryLen(), res.end_state.GetHistoryLen());
+  EXPECT_EQ(plain.num_moves, res.num_moves);
+  EXPECT_EQ(plain.num_visited_states, res.num_visited_states);
+  EXPECT_EQ(plain.num_visited_hit_drop, res.num_visited_hit_drop);
+  EXPECT_LT(0, res.stats.visited_filter_negatives);
+  EXPECT_GE(res.num_visited_states, res.stats.visited_filter_negatives);
+  // Sized from a node budget.
+  options.max_nodes = 1000000;
+  EXPECT_EQ(plain.num_moves,
+            solve(Board(B003, REAL_RULES), State(B003), options).num_moves);
+}
+
+TEST(TestSolve, Progress) {
+  vector<SolveProgress> reports;
+  SolveOptions options;
+  options.progress_every_nodes = 2;
+  options.progress = [&reports](const SolveProgress& p) {
+    reports.push_back(p);
+  };
+  const SolveResult res = solve(Board(B003, REAL_RULES), State(B003), options);
+  ASSERT_TRUE(res.success);
+  ASSERT_LT(1, reports.size());
+  for (size_t i = 0; i < reports.size(); ++i) {
+    EXPECT_EQ(2 * (long long)(i + 1), reports[i].num_expanded);
+    EXPECT_GE(6, reports[i].min_moves);
+    EXPECT_LT(0, reports[i].visited);
+    EXPECT_LT(0, reports[i].bytes);
+    if (i > 0) {
+      EXPECT_LE(reports[i - 1].min_moves, reports[i].min_moves);
+    }
+  }
+
+  // A dump request during the solve prints one line at the next state.
+  options.progress_every_nodes = 1;
+  options.progress = [](const SolveProgress& p) {
+    if (p.num_expanded == 1) RequestProgressDump();
+  };
+  testing::internal::CaptureStderr();
+  solve(Board(B003, REAL_RULES), State(B003), options);
+  const string dump = testing::internal::GetCapturedStderr();
+  EXPECT_EQ(0, dump.find("min:"));
+  EXPECT_EQ(dump.size() - 1, dump.find('\n'));
+}
+
+// Builds the tablebase of bs and plays its hints from the start state.
+void CheckTablebase(const char* bs, int exp_distance, bool exp_ranked) {
+  Board b(bs, REAL_RULES);
+  State s(bs);
+  const string path = "/tmp/gtn_solve_test.tb";
+  EXPECT_LT(0, BuildTablebase(b, s, path));
+  Tablebase tb;
+  ASSERT_TRUE(tb.Open(path, b));
+  EXPECT_EQ(exp_ranked, tb.Ranked());
+  EXPECT_EQ(exp_distance, tb.Distance(b, s));
+  State curr = s;
+  int tile_index, dir;
+  for (int d = exp_distance; d > 0; --d) {
+    ASSERT_TRUE(tb.BestMove(b, curr, &tile_index, &dir));
+    State next;
+    int move_res = curr.Move(b, tile_index, dir, &next);
+    EXPECT_EQ(d == 1 ? State::WIN : 0, move_res);
+    EXPECT_EQ(d == 1 ? Tablebase::UNKNOWN : d - 1, tb.Distance(b, next));
+    curr = next;
+  }
+  unlink(path.c_str());
+}
+
+TEST(TestSolve, Tablebase) {
+  CheckTablebase(B001, 1, true);
+  CheckTablebase(B002, 4, true);
+  CheckTablebase(B003, 6, true);
+  // 3e11 ranks, the keys are stored instead.
+  CheckTablebase(B004, 6, false);
+  CheckTablebase(B005, 5, true);
+}
+
+TEST(TestSolve, TablebaseOtherLevel) {
+  Board b(B003, REAL_RULES);
+  State s(B003);
+  Board other(B002, REAL_RULES);
+  const string path = "/tmp/gtn_solve_test_other.tb";
+  EXPECT_LT(0, BuildTablebase(b, s, path));
+  Tablebase tb;
+  EXPECT_FALSE(tb.Open(path, other));
+  ASSERT_TRUE(tb.Open(path, b));
+  EXPECT_EQ(Tablebase::UNKNOWN, tb.Distance(other, State(B002)));
+  int tile_index, dir;
+  EXPECT_FALSE(tb.BestMove(other, State(B002), &tile_index, &dir));
+  // Another board of the level is checked once and then remembered.
+  Board same(B003, REAL_RULES);
+  EXPECT_EQ(tb.Distance(b, s), tb.Distance(same, s));
+  EXPECT_EQ(tb.Distance(b, s), tb.Distance(same, s));
+  EXPECT_EQ(Tablebase::UNKNOWN, tb.Distance(other, State(B002)));
+  unlink(path.c_str());
+}
+
+TEST(TestSolve, TablebaseNoWin) {
+  const char B[] =
+    "##########"
+    "#a       #"
+    "####j#####"
+    "#        #"
+    "#   b    #"
+    "#        #"
+    "#        #"
+    "##########";
+  Board b(B, REAL_RULES);
+  State s(B);
+  const string path = "/tmp/gtn_solve_test_nowin.tb";
+  EXPECT_EQ(1, BuildTablebase(b, s, path));
+  Tablebase tb;
+  ASSERT_TRUE(tb.Open(path, b));
+  EXPECT_EQ(Tablebase::NO_WIN, tb.Distance(b, s));
+  int tile_index, dir;
+  EXPECT_FALSE(tb.BestMove(b, s, &tile_index, &dir));
+  unlink(path.c_str());
+  EXPECT_FALSE(tb.Open(path, b));
+}
+
+TEST(TestSolve, SolverFollowsHints) {
+  Board b(B003, REAL_RULES);
+  State s(B003);
+  Solver solver(b);
+  EXPECT_EQ(6, solver.Distance(s));
+  EXPECT_EQ(1, solver.NumSearches());
+  int tile_index, dir;
+  for (int d = 6; d > 0; --d) {
+    EXPECT_EQ(d, solver.Distance(s));
+    ASSERT_TRUE(solver.NextMove(s, &tile_index, &dir));
+    State next;
+    EXPECT_EQ(d == 1 ? State::WIN : 0, s.Move(b, tile_index, dir, &next));
+    s = next;
+  }
+  // The whole solution came from the first search.
+  EXPECT_EQ(1, solver.NumSearches());
+  EXPECT_LT(0, solver.NumLearned());
+}
+
+TEST(TestSolve, SolverAfterDetour) {
+  Board b(B004, REAL_RULES);
+  State s(B004);
+  Solver solver(b);
+  EXPECT_EQ(6, solver.Distance(s));
+  // Try every first move, each answer must match a search from scratch.
+  for (int ti = 0; ti < s.NumTiles(); ++ti) {
+    if (!MOVEABLE[s.GetTile(ti).type]) continue;
+    for (int di = 0; di < 4; ++di) {
+      State next;
+      if (s.Move(b, ti, di, &next) != 0) continue;
+      next.ClearHistory();
+      const SolveResult res = solve(b, next);
+      EXPECT_EQ(res.success ? res.end_state.GetHistoryLen() : -1,
+                solver.Distance(next));
+    }
+  }
+  EXPECT_LT(1, solver.NumSearches());
+  EXPECT_LT(0, solver.NumCacheHits());
+}
@@ -1,52 +1,189 @@
+#include <signal.h>
 #include <cstdlib>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "board.h"
+#include "cache.h"
 #include "convert.h"
+#include "distributed.h"
+#include "level.h"
+#include "perf.h"
+#include "playout.h"
+#include "rank.h"
 #include "rules.h"
 #include "utils.h"
 #include "solve.h"
+#include "stats.h"
 
 using namespace std;
 
 static Rules REAL_RULES = Rules("rules-real.csv");
 
-int main(int argc, char **argv) {
-  char bc[] =
-    "##########"
-    "#        #"
-    "#        #"
-    "#        #"
-    "#        #"
-    "#        #"
-    "#        #"
-    "##########";
-  for (int i = 0; i < 6; ++i) {
-    std::string st;
-    std::cin >> st;
-    vector<string> values;
-    SplitString(st, ",", &values);
-    if (values.size() != 8) {
-      cout << "Broken line in csv: " << st;
-      exit(2);
+// Set from $GTN_SOLUTION_CACHE, the file of earlier solutions.
+static SolutionCache* solution_cache = NULL;
+
+// Moves of a random playout before it gives up.
+static const int PLAYOUT_LENGTH = 100;
+
+// Set with $GTN_PERF, counts the hardware events of the solve.
+static PerfCounters* perf = NULL;
+
+// Events of the last solve per expanded state, and the instructions per
+// cycle, as CSV values. Empty values for events that were not counted.
+static string PerfColumns(int num_expanded) {
+  const long long cycles = perf->Value(PERF_CYCLES);
+  const long long instructions = perf->Value(PERF_INSTRUCTIONS);
+  stringstream ss;
+  if (cycles > 0 && instructions >= 0) ss << (double)instructions / cycles;
+  ss << ",";
+  const int events[] = { PERF_L1D_MISSES, PERF_LLC_MISSES,
+                         PERF_BRANCH_MISSES };
+  for (int i = 0; i < 3; ++i) {
+    const long long n = perf->Value(events[i]);
+    if (n >= 0 && num_expanded > 0) ss << (double)n / num_expanded;
+    ss << ",";
+  }
+  return ss.str();
+}
+
+// Solves a level of rows x columns cells on the smallest board geometry it
+// fits into. Missing cells are filled with walls.
+// mode: "" prints the solution, "relevance" prints the tiles left out of the
+// search, "enumerate" counts the reachable states, "hint" plays the level with
+// a Solver and times each hint, "tablebase" writes the level's tablebase to
+// arg and plays the hinted moves, "playout" plays arg random games per thread,
+// $GTN_THREADS threads, and prints the moves per second, anything else prints
+// a RESULTS.csv line.
+template <class G>
+int SolveLevel(const Level& level, const string& mode, const string& arg) {
+  char bc[G::BOARD_SIZE + 1];
+  LevelToBoard<G>(level, bc);
+  bc[G::BOARD_SIZE] = 0;
+  BasicBoard<G> b(bc, REAL_RULES);
+  BasicState<G> s(bc);
+  if (mode == "relevance") {
+    std::cout << b.NumIrrelevant() << " irrelevant tiles, state space "
+              << "reduction: " << b.StateSpaceReduction() << "x" << std::endl
+              << b.DebugStringWithRelevance(s);
+    return 0;
+  }
+  if (mode == "enumerate") {
+    const EnumerationResult res = EnumerateStates(b, s);
+    cout << "rank space: " << res.rank_space << " states";
+    if (res.num_states < 0) {
+      cout << ", too large to enumerate" << endl;
+      return 0;
+    }
+    cout << ", " << res.rank_space / 8 / (1 << 20) << "MB visited bits"
+         << endl << "reachable: " << res.num_states << " states in "
+         << res.num_layers << " layers, win in " << res.win_moves << " moves"
+         << endl;
+    return 0;
+  }
+  if (mode == "playout") {
+    const long long playouts = arg.empty() ? 100000 : atoll(arg.c_str());
+    const char* threads_env = getenv("GTN_THREADS");
+    int num_threads = threads_env != NULL ? atoi(threads_env)
+                                          : thread::hardware_concurrency();
+    if (num_threads < 1) num_threads = 1;
+    vector<PlayoutStats> per_thread;
+    const PlayoutStats total = ParallelPlayouts(b, s, num_threads, playouts,
+                                                PLAYOUT_LENGTH, &per_thread);
+    for (int i = 0; i < num_threads; ++i) {
+      cout << "thread " << i << ": " << per_thread[i].num_moves << " moves, "
+           << (long long)per_thread[i].MovesPerSec() << " moves/s" << endl;
     }
-    for (int x = 0; x < 8; ++x) {
-      if (values[x].find("TRE") != string::npos) {
-        bc[(i+1)*10+(x+1)] = '#';
-      } else {
-        bc[(i+1)*10+(x+1)] = TriToCode(values[x].substr(0, 3).c_str());
-      }
+    cout << "total: " << total.num_playouts << " playouts, "
+         << total.num_moves << " moves, " << (long long)total.MovesPerSec()
+         << " moves/s, " << total.num_wins << " wins, " << total.num_losses
+         << " losses, " << (double)total.total_length / total.num_playouts
+         << " moves per playout" << endl;
+    return 0;
+  }
+  if (mode == "hint") {
+    BasicSolver<G> solver(b);
+    BasicState<G> curr = s;
+    int tile_index, dir;
+    while (true) {
+      const long long start = NowMicros();
+      if (!solver.NextMove(curr, &tile_index, &dir)) break;
+      const long long us = NowMicros() - start;
+      const Tile& tile = curr.GetTile(tile_index);
+      cout << "(" << tile.pos / G::BOARD_X << "," << tile.pos % G::BOARD_X
+           << ")-" << CodeToTri('a' + tile.type) << "-"
+           << BasicState<G>::DIRNAME[dir] << " " << us << "us" << endl;
+      BasicState<G> next;
+      if (curr.Move(b, tile_index, dir, &next) == BasicState<G>::WIN) break;
+      curr = next;
+      curr.ClearHistory();
     }
+    cout << solver.NumSearches() << " searches, " << solver.NumCacheHits()
+         << " cache hits" << endl;
+    return 0;
+  }
+  if (mode == "tablebase") {
+    const string path = arg.empty() ? "tablebase.bin" : arg;
+    const long long num_states = BuildTablebase(b, s, path);
+    BasicTablebase<G> tb;
+    if (num_states < 0 || !tb.Open(path, b)) {
+      cout << "Can't write tablebase " << path << endl;
+      exit(3);
+    }
+    cout << num_states << " states, max distance " << tb.MaxDistance()
+         << ", start distance " << tb.Distance(b, s) << endl;
+    BasicState<G> curr = s;
+    int tile_index, dir;
+    while (tb.BestMove(b, curr, &tile_index, &dir)) {
+      const Tile& tile = curr.GetTile(tile_index);
+      cout << "(" << tile.pos / G::BOARD_X << "," << tile.pos % G::BOARD_X
+           << ")-" << CodeToTri('a' + tile.type) << "-"
+           << BasicState<G>::DIRNAME[dir] << endl;
+      BasicState<G> next;
+      if (curr.Move(b, tile_index, dir, &next) == BasicState<G>::WIN) break;
+      curr = next;
+      curr.ClearHistory();
+    }
+    return 0;
   }
-  Board b(bc, REAL_RULES);
-  State s(bc);
-  const SolveResult res = solve(b, s);
-  const std::string sol = ReplaySolution(b,
-                                         s,
-                                         res.end_state.GetHistory(),
-                                         res.end_state.GetHistoryLen());
-  if (argc > 1) {
+  SolveOptions options;
+  const char* progress_ms = getenv("GTN_PROGRESS_MS");
+  if (progress_ms != NULL && atoi(progress_ms) > 0) {
+    options.progress_every_us = atoi(progress_ms) * 1000LL;
+    options.progress = [](const SolveProgress& p) {
+      cerr << FormatProgress(p) << endl;
+    };
+  }
+  const char* stats_format = getenv("GTN_STATS");
+  options.collect_stats = stats_format != NULL && *stats_format != 0;
+  const char* huge_pages = getenv("GTN_HUGE_PAGES");
+  options.huge_pages = huge_pages != NULL && *huge_pages != 0;
+  const char* visited_filter = getenv("GTN_VISITED_FILTER");
+  options.visited_filter = visited_filter != NULL && *visited_filter != 0;
+  if (perf != NULL) perf->Start();
+  const BasicSolveResult<G> res =
+      SolveCached(solution_cache, REAL_RULES, b, s, bc, level[0].size(),
+                  level.size(), options);
+  if (perf != NULL) perf->Stop();
+  SearchStats stats = res.stats;
+  std::string sol;
+  {
+    ScopedPhaseTimer timer(options.collect_stats ? &stats : NULL,
+                           PHASE_REPLAY);
+    sol = ReplaySolution(b, s, res.end_state.GetHistory(),
+                         res.end_state.GetHistoryLen());
+  }
+  if (options.collect_stats) {
+    if (string(stats_format) == "csv") {
+      cerr << SearchStats::CsvHeader() << endl << stats.ToCsv() << endl;
+    } else {
+      cerr << stats.ToJson() << endl;
+    }
+  }
+  if (!mode.empty()) {
     std::cout
       << res.end_state.GetHistoryLen() << ","
       << "\"" << sol << "\","
@@ -55,9 +192,17 @@ int main(int argc, char **argv) {
       << res.num_visited_states << ","
       << res.num_visited_hit_improve << ","
       << res.num_visited_hit_drop << ","
+      << (perf != NULL ? PerfColumns(res.num_expanded) : "")
       << std::endl;
     return 0;
   }
+  if (perf != NULL) {
+    cout << "PERF:";
+    for (int i = 0; i < NUM_PERF_EVENTS; ++i) {
+      cout << " " << PerfEventName(i) << "=" << perf->Value(i);
+    }
+    cout << " expanded=" << res.num_expanded << endl;
+  }
   std::cout << "SOLUTION:" << (res.success ? "Y" : "N") << " "
             <<"(" << res.end_state.GetHistoryLen() << ") " << std::endl;
   vector<string> sol_moves;
@@ -65,26 +210,119 @@ int main(int argc, char **argv) {
   for (int i = 0; i < sol_moves.size(); ++i) {
     cout << sol_moves[i] << endl;
   }
-  // std::cout << "num_moves: "
-  //   << res.num_moves << std::endl;
-  // std::cout << "num_visited_states: "
-  //   << res.num_visited_states << std::endl;
-  // std::cout << "num_visited_hit_improve: "
-  //   << res.num_visited_hit_improve << std::endl;
-  // std::cout << "num_visited_hit_drop: "
-  //   << res.num_visited_hit_drop << std::endl;
-  // std::cout << "max_mem_state: "
-  //   << res.max_mem_state << std::endl;
+  return 0;
+}
 
-  if (!res.success) {
-    return 0;
+// Prints the solution of a distributed search as SolveLevel() does, and the
+// share of each worker to stderr.
+static void PrintDistributed(const vector<DistributedResult>& results) {
+  string sol;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const DistributedResult& r = results[i];
+    if (!r.solution.empty()) sol = r.solution;
+    cerr << "worker " << i << ": expanded=" << r.num_expanded
+         << " visited=" << r.num_visited_states << " sent=" << r.states_sent
+         << " received=" << r.states_received
+         << " visited_bytes=" << r.visited_bytes << " rounds=" << r.num_rounds
+         << endl;
+  }
+  if (results.empty()) return;
+  cout << "SOLUTION:" << (results[0].status == SOLVED ? "Y" : "N") << " "
+       << "(" << max(results[0].length, 0) << ") " << endl;
+  vector<string> sol_moves;
+  SplitString(sol, "/", &sol_moves);
+  for (size_t i = 0; i < sol_moves.size(); ++i) cout << sol_moves[i] << endl;
+}
+
+// "distributed workers" solves with that many local worker processes,
+// "distributed rank host:port,..." runs worker rank of the listed ones.
+static int SolveDistributed(const Level& level, int argc, char** argv) {
+  vector<DistributedResult> results;
+  string error;
+  bool ok;
+  if (argc == 3) {
+    ok = RunLocalWorkers(level, atoi(argv[2]), &results, &error);
+  } else {
+    const int rank = atoi(argv[2]);
+    vector<string> peers;
+    SplitString(argv[3], ",", &peers);
+    if (rank < 0 || rank >= (int)peers.size()) {
+      cout << "No worker " << rank << endl;
+      exit(2);
+    }
+    const int listen_fd = ListenTcp(peers[rank], NULL);
+    if (listen_fd < 0) {
+      cout << "Can't listen on " << peers[rank] << endl;
+      exit(3);
+    }
+    results.resize(1);
+    ok = DistributedSolve(level, rank, peers, listen_fd, &results[0], &error);
+  }
+  if (!ok) {
+    cout << error << endl;
+    exit(3);
+  }
+  PrintDistributed(results);
+  return 0;
+}
+
+static void DumpProgress(int) {
+  RequestProgressDump();
+}
+
+// $GTN_PROGRESS_MS prints the progress of the solve to stderr that often,
+// SIGUSR1 prints it once. $GTN_STATS=json or csv prints the SearchStats of
+// the solve to stderr, empty ones on a solution cache hit. $GTN_PERF counts
+// hardware events of the solve, skipping the solution cache, and adds IPC and
+// misses per expanded state to the RESULTS.csv line. $GTN_HUGE_PAGES puts the
+// visited states on huge pages, $GTN_VISITED_FILTER puts a Bloom filter in
+// front of them. The distributed mode is described at SolveDistributed().
+int main(int argc, char **argv) {
+  signal(SIGUSR1, DumpProgress);
+  // One csv line per row, the standard levels have 6 rows of 8 cells.
+  Level level;
+  std::string st;
+  while (std::cin >> st) {
+    std::string error;
+    if (!AddLevelRow(st, &level, &error)) {
+      cout << error;
+      exit(2);
+    }
+  }
+  if (level.empty()) {
+    cout << "Empty level" << endl;
+    exit(2);
+  }
+  const int height = level.size();
+  const int width = level[0].size();
+  static SolutionCache cache;
+  const char* cache_path = getenv("GTN_SOLUTION_CACHE");
+  if (cache_path != NULL && *cache_path != 0) {
+    if (!cache.Open(cache_path)) {
+      cout << "Can't open solution cache: " << cache_path << endl;
+      exit(3);
+    }
+    solution_cache = &cache;
+  }
+  static PerfCounters perf_counters;
+  const char* perf_env = getenv("GTN_PERF");
+  if (perf_env != NULL && *perf_env != 0) {
+    string error;
+    // Without counters the columns stay empty.
+    if (!perf_counters.Open(&error)) cerr << error << endl;
+    perf = &perf_counters;
+    solution_cache = NULL;
+  }
+  if (argc > 2 && string(argv[1]) == "distributed") {
+    return SolveDistributed(level, argc, argv);
+  }
+#define TRY_GEOMETRY(G)                                       \
+  if (width + 2 <= G::BOARD_X && height + 2 <= G::BOARD_Y) {  \
+    return SolveLevel<G>(level, argc > 1 ? argv[1] : "",      \
+                         argc > 2 ? argv[2] : "");            \
   }
-  // std::cout << b.DebugStringWithState(s);
-  // State curr_state = s;
-  // for (int i = 0; i < sol.size(); ++i) {
-  //   State new_state;
-  //   curr_state.Move(b, MoveFromChar(sol[i]), &new_state);
-  //   std::cout << b.DebugStringWithState(new_state);
-  //   curr_state = new_state;
-  // }
+  GTN_FOR_EACH_GEOMETRY(TRY_GEOMETRY)
+#undef TRY_GEOMETRY
+  cout << "Level too big: " << height << "x" << width << endl;
+  exit(2);
 }
@@ -0,0 +1,116 @@
+#include <string.h>
+#include <sstream>
+#include <string>
+
+#include "stats.h"
+
+using namespace std;
+
+const char* SearchPhaseName(int phase) {
+  static const char* NAMES[NUM_PHASES] = {
+    "move", "hash", "visited", "push", "pop", "replay"
+  };
+  return phase >= 0 && phase < NUM_PHASES ? NAMES[phase] : "unknown";
+}
+
+Histogram::Histogram() {
+  memset(buckets, 0, sizeof(buckets));
+}
+
+void Histogram::Merge(const Histogram& other) {
+  for (int i = 0; i < NUM_BUCKETS; ++i) buckets[i] += other.buckets[i];
+}
+
+long long Histogram::Count() const {
+  long long n = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i) n += buckets[i];
+  return n;
+}
+
+double Histogram::Mean() const {
+  long long n = 0;
+  long long sum = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i) {
+    n += buckets[i];
+    sum += buckets[i] * i;
+  }
+  return n > 0 ? (double)sum / n : 0;
+}
+
+string Histogram::ToJson() const {
+  int size = NUM_BUCKETS;
+  while (size > 0 && buckets[size - 1] == 0) --size;
+  stringstream ss;
+  ss << "[";
+  for (int i = 0; i < size; ++i) ss << (i > 0 ? ", " : "") << buckets[i];
+  ss << "]";
+  return ss.str();
+}
+
+SearchStats::SearchStats()
+  : num_solves(0),
+    num_expanded(0),
+    num_generated(0),
+    slide_cache_lookups(0),
+    slide_cache_hits(0),
+    visited_filter_negatives(0) {
+  memset(phase_cycles, 0, sizeof(phase_cycles));
+  memset(phase_calls, 0, sizeof(phase_calls));
+}
+
+void SearchStats::Merge(const SearchStats& other) {
+  num_solves += other.num_solves;
+  num_expanded += other.num_expanded;
+  num_generated += other.num_generated;
+  slide_cache_lookups += other.slide_cache_lookups;
+  slide_cache_hits += other.slide_cache_hits;
+  visited_filter_negatives += other.visited_filter_negatives;
+  for (int i = 0; i < NUM_PHASES; ++i) {
+    phase_cycles[i] += other.phase_cycles[i];
+    phase_calls[i] += other.phase_calls[i];
+  }
+  branching.Merge(other.branching);
+  slide_length.Merge(other.slide_length);
+  f_gap.Merge(other.f_gap);
+}
+
+string SearchStats::ToJson() const {
+  stringstream ss;
+  ss << "{\"solves\": " << num_solves << ", \"expanded\": " << num_expanded
+     << ", \"generated\": " << num_generated << ", \"phases\": {";
+  for (int i = 0; i < NUM_PHASES; ++i) {
+    ss << (i > 0 ? ", " : "") << "\"" << SearchPhaseName(i)
+       << "\": {\"cycles\": " << phase_cycles[i] << ", \"calls\": "
+       << phase_calls[i] << "}";
+  }
+  ss << "}, \"branching\": " << branching.ToJson()
+     << ", \"slide_length\": " << slide_length.ToJson()
+     << ", \"f_gap\": " << f_gap.ToJson()
+     << ", \"slide_cache\": {\"lookups\": " << slide_cache_lookups
+     << ", \"hits\": " << slide_cache_hits << "}"
+     << ", \"visited_filter_negatives\": " << visited_filter_negatives << "}";
+  return ss.str();
+}
+
+string SearchStats::CsvHeader() {
+  string header = "solves,expanded,generated";
+  for (int i = 0; i < NUM_PHASES; ++i) {
+    header += string(",") + SearchPhaseName(i) + "_cycles," +
+              SearchPhaseName(i) + "_calls";
+  }
+  return header + ",mean_branching,mean_slide_length,mean_f_gap,"
+                  "slide_cache_lookups,slide_cache_hits,"
+                  "visited_filter_negatives";
+}
+
+string SearchStats::ToCsv() const {
+  stringstream ss;
+  ss << num_solves << "," << num_expanded << "," << num_generated;
+  for (int i = 0; i < NUM_PHASES; ++i) {
+    ss << "," << phase_cycles[i] << "," << phase_calls[i];
+  }
+  ss << "," << branching.Mean() << "," << slide_length.Mean() << ","
+     << f_gap.Mean() << "," << slide_cache_lookups << "," << slide_cache_hits
+     << "," << visited_filter_negatives;
+  return ss.str();
+}
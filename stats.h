@@ -0,0 +1,105 @@
+#ifndef _GTN_STATS_H__
+#define _GTN_STATS_H__
+
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Timestamp counter, or nanoseconds where there is none.
+inline unsigned long long ReadCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Parts of a search timed by SearchStats.
+enum SearchPhase {
+  PHASE_MOVE,     // State::Move() and the dead state check.
+  PHASE_HASH,     // State::Hash() and the lower bound.
+  PHASE_VISITED,  // Lookups and inserts of the visited map.
+  PHASE_PUSH,     // Adding to and removing from the open list.
+  PHASE_POP,
+  PHASE_REPLAY,   // ReplaySolution().
+  NUM_PHASES,
+};
+
+// "move", "hash" and so on.
+const char* SearchPhaseName(int phase);
+
+// Counts of small values, the last bucket takes everything bigger.
+struct Histogram {
+  static const int NUM_BUCKETS = 32;
+
+  Histogram();
+  void Add(int value) {
+    if (value < 0) value = 0;
+    if (value >= NUM_BUCKETS) value = NUM_BUCKETS - 1;
+    ++buckets[value];
+  }
+  void Merge(const Histogram& other);
+  long long Count() const;
+  double Mean() const;
+  // [n0, n1, ...] without the trailing empty buckets.
+  std::string ToJson() const;
+
+  long long buckets[NUM_BUCKETS];
+};
+
+// Instrumentation of a solve, filled when SolveOptions::stats is set. Every
+// solve runs on one thread and owns its SearchStats; Merge() adds up those
+// of several solves.
+struct SearchStats {
+  SearchStats();
+  void Merge(const SearchStats& other);
+
+  std::string ToJson() const;
+  // One line of values, in the order of CsvHeader().
+  static std::string CsvHeader();
+  std::string ToCsv() const;
+
+  long long num_solves;
+  long long num_expanded;
+  long long num_generated;
+  // Moves looked up in and found in the board's slide cache.
+  long long slide_cache_lookups;
+  long long slide_cache_hits;
+  // Visited checks the Bloom filter answered without the visited table.
+  long long visited_filter_negatives;
+  long long phase_cycles[NUM_PHASES];
+  long long phase_calls[NUM_PHASES];
+  // Successors kept per expanded state.
+  Histogram branching;
+  // Cells the moving tile slid.
+  Histogram slide_length;
+  // f of a kept successor minus f of its parent, 0 when the lower bound
+  // is exact along the move.
+  Histogram f_gap;
+};
+
+// Adds the cycles of its lifetime to a phase of stats, nothing if stats is
+// NULL.
+class ScopedPhaseTimer {
+ public:
+  ScopedPhaseTimer(SearchStats* stats, SearchPhase phase)
+    : stats(stats), phase(phase), start(stats != NULL ? ReadCycles() : 0) {}
+  ~ScopedPhaseTimer() {
+    if (stats == NULL) return;
+    stats->phase_cycles[phase] += ReadCycles() - start;
+    ++stats->phase_calls[phase];
+  }
+
+ private:
+  SearchStats* stats;
+  SearchPhase phase;
+  unsigned long long start;
+};
+
+#endif // _GTN_STATS_H__
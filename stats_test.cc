@@ -0,0 +1,69 @@
+#include <string>
+
+#include "stats.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+TEST(TestStats, Histogram) {
+  Histogram h;
+  EXPECT_EQ(0, h.Count());
+  EXPECT_EQ(0, h.Mean());
+  EXPECT_EQ("[]", h.ToJson());
+  h.Add(1);
+  h.Add(3);
+  h.Add(-2);
+  EXPECT_EQ(3, h.Count());
+  EXPECT_DOUBLE_EQ(4.0 / 3, h.Mean());
+  EXPECT_EQ("[1, 1, 0, 1]", h.ToJson());
+  // Big values go to the last bucket.
+  h.Add(1000);
+  EXPECT_EQ(1, h.buckets[Histogram::NUM_BUCKETS - 1]);
+  Histogram other;
+  other.Add(1);
+  h.Merge(other);
+  EXPECT_EQ(2, h.buckets[1]);
+}
+
+TEST(TestStats, Export) {
+  SearchStats a;
+  a.num_solves = 1;
+  a.num_expanded = 10;
+  a.branching.Add(2);
+  a.slide_cache_lookups = 5;
+  a.slide_cache_hits = 3;
+  a.visited_filter_negatives = 7;
+  SearchStats b = a;
+  b.phase_cycles[PHASE_HASH] = 100;
+  b.phase_calls[PHASE_HASH] = 4;
+  a.Merge(b);
+  EXPECT_EQ(2, a.num_solves);
+  EXPECT_EQ(20, a.num_expanded);
+  EXPECT_EQ(2, a.branching.buckets[2]);
+  const string json = a.ToJson();
+  EXPECT_EQ(0, json.find("{\"solves\": 2, \"expanded\": 20, "));
+  EXPECT_NE(string::npos,
+            json.find("\"hash\": {\"cycles\": 100, \"calls\": 4}"));
+  EXPECT_NE(string::npos, json.find("\"branching\": [0, 0, 2]"));
+  EXPECT_NE(string::npos,
+            json.find("\"slide_cache\": {\"lookups\": 10, \"hits\": 6}"));
+  EXPECT_NE(string::npos, json.find("\"visited_filter_negatives\": 14}"));
+  // As many CSV values as columns.
+  const string header = SearchStats::CsvHeader();
+  const string csv = a.ToCsv();
+  EXPECT_EQ(count(header.begin(), header.end(), ','),
+            count(csv.begin(), csv.end(), ','));
+  EXPECT_EQ(0, header.find("solves,expanded,generated,move_cycles,"));
+}
+
+TEST(TestStats, ScopedPhaseTimer) {
+  SearchStats stats;
+  {
+    ScopedPhaseTimer timer(&stats, PHASE_POP);
+    ScopedPhaseTimer off(NULL, PHASE_POP);
+  }
+  EXPECT_EQ(1, stats.phase_calls[PHASE_POP]);
+  EXPECT_LE(0, stats.phase_cycles[PHASE_POP]);
+  EXPECT_STREQ("replay", SearchPhaseName(PHASE_REPLAY));
+}
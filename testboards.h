@@ -48,3 +48,14 @@ static const char B005[] =
     "#  c     #"
     "##########";
 
+
+// 16 tiles, needs a 192 bit key.
+static const char B006[] =
+    "##########"
+    "#a#  e  d#"
+    "#d# d  e #"
+    "#   b   d#"
+    "#d  d e  #"
+    "#  d   d #"
+    "#d e   d #"
+    "##########";
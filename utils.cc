@@ -1,3 +1,4 @@
+#include <time.h>
 #include <algorithm>
 
 #include "utils.h"
@@ -25,3 +26,18 @@ void SplitString(const string& s, const string& delim, vector<string> *result) {
 }
 
 
+
+long long NowMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+unsigned long long HashBytes(const void* data, int n, unsigned long long h) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (int i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
@@ -1,5 +1,5 @@
-#ifndef GTN_RULES_H_
-#define GTN_RULES_H_
+#ifndef GTN_UTILS_H_
+#define GTN_UTILS_H_
 
 #include <string>
 #include <vector>
@@ -8,4 +8,11 @@ void SplitString(const std::string& s,
                  const std::string& delim,
                  std::vector<std::string> *result);
 
+// FNV-1a hash of n bytes, continuing from h.
+unsigned long long HashBytes(const void* data, int n,
+                             unsigned long long h = 14695981039346656037ULL);
+
+// Microseconds on a monotonic clock.
+long long NowMicros();
+
 #endif
@@ -0,0 +1,147 @@
+#ifndef _GTN_VISITED_H__
+#define _GTN_VISITED_H__
+
+#include <algorithm>
+#include <new>
+
+#include "bloom.h"
+#include "board.h"
+#include "pages.h"
+
+// Open addressing hash table from StateKey<WORDS> to the min_moves of a
+// visited state, with linear probing. A key and its value share a slot, so a
+// lookup usually touches one cache line, which Prefetch() can fetch ahead.
+// The slots live in a PageBuffer, on huge pages if asked for.
+//
+// With filter, a BlockedBloomFilter of the inserted keys answers most
+// lookups of new keys without probing the slots. It has room for
+// expected_entries keys, or as many as the slots hold if that is more, and
+// is rebuilt when the slots outgrow it.
+//
+// Like std::map, Insert() throws std::bad_alloc when the memory runs out.
+template <int WORDS>
+class VisitedTable {
+ public:
+  typedef StateKey<WORDS> Key;
+
+  explicit VisitedTable(bool huge_pages = false, bool filter = false,
+                        long long expected_entries = 0)
+    : huge_pages(huge_pages), use_filter(filter),
+      expected_entries(expected_entries), filter_keys(0),
+      filter_negatives(0), num_entries(0), num_slots(0), shift(64) {
+    Resize(INITIAL_SIZE);
+  }
+
+  long long size() const { return num_entries; }
+  // Memory of the slots and the filter.
+  long long Bytes() const {
+    return (long long)num_slots * sizeof(Slot) + filter.Bytes();
+  }
+  PageKind Pages() const { return buffer.kind(); }
+  // Find() calls the filter answered alone.
+  long long FilterNegatives() const { return filter_negatives; }
+
+  // Starts loading the slot of key into the cache, and its filter block.
+  void Prefetch(const Key& key) const {
+    const unsigned long long h = Hash(key);
+    if (use_filter) filter.Prefetch(h);
+    __builtin_prefetch(&slots()[h >> shift]);
+  }
+
+  // Whether key is there, value gets its value.
+  bool Find(const Key& key, int* value) const {
+    const unsigned long long h = Hash(key);
+    if (use_filter && !filter.MayContain(h)) {
+      ++filter_negatives;
+      return false;
+    }
+    const Slot* s = slots();
+    for (size_t i = h >> shift;; i = (i + 1) & (num_slots - 1)) {
+      if (s[i].value == EMPTY) return false;
+      if (s[i].key == key) {
+        *value = s[i].value - 1;
+        return true;
+      }
+    }
+  }
+
+  // Adds key with value unless it is there, as std::map::insert() does.
+  void Insert(const Key& key, int value) {
+    if (2 * (num_entries + 1) > (long long)num_slots) Resize(2 * num_slots);
+    const unsigned long long h = Hash(key);
+    Slot* s = slots();
+    for (size_t i = h >> shift;; i = (i + 1) & (num_slots - 1)) {
+      if (s[i].value == EMPTY) {
+        if (use_filter) filter.Add(h);
+        s[i].key = key;
+        s[i].value = value + 1;
+        ++num_entries;
+        return;
+      }
+      if (s[i].key == key) return;
+    }
+  }
+
+ private:
+  static const size_t INITIAL_SIZE = 1024;
+  // Values are stored plus one, so that the zeroed memory of a fresh buffer
+  // is all empty slots without touching it.
+  static const int EMPTY = 0;
+
+  struct Slot {
+    Key key;
+    int value;
+  };
+
+  Slot* slots() const { return (Slot*)buffer.data(); }
+
+  // A multiplicative hash, the slot is its top bits. Keys are packed from
+  // the most significant bit, their low bits are often 0.
+  unsigned long long Hash(const Key& key) const {
+    unsigned long long h = 0;
+    for (int i = 0; i < WORDS; ++i) {
+      h = (h ^ key.w[i]) * 0x9E3779B97F4A7C15ULL;
+      h ^= h >> 32;
+    }
+    return h * 0x9E3779B97F4A7C15ULL;
+  }
+
+  // Moves the entries to size slots, a power of 2. Throws std::bad_alloc,
+  // leaving the table as it was, if the memory can't be mapped.
+  void Resize(size_t size) {
+    PageBuffer old;
+    if (!old.Allocate(size * sizeof(Slot), huge_pages)) throw std::bad_alloc();
+    if (use_filter && (long long)size / 2 > filter_keys) {
+      const long long keys = std::max((long long)size / 2, expected_entries);
+      filter.Reset(keys, huge_pages);
+      filter_keys = keys;
+    }
+    old.Swap(&buffer);
+    const size_t old_slots = num_slots;
+    num_slots = size;
+    shift = 64;
+    for (size_t s = size; s > 1; s /= 2) --shift;
+    num_entries = 0;
+    const Slot* o = (const Slot*)old.data();
+    for (size_t i = 0; i < old_slots; ++i) {
+      if (o[i].value != EMPTY) Insert(o[i].key, o[i].value - 1);
+    }
+  }
+
+  const bool huge_pages;
+  const bool use_filter;
+  const long long expected_entries;
+  BlockedBloomFilter filter;
+  // Keys the filter has room for.
+  long long filter_keys;
+  mutable long long filter_negatives;
+  PageBuffer buffer;
+  long long num_entries;
+  size_t num_slots;
+  int shift;
+
+  VisitedTable(const VisitedTable&);
+  VisitedTable& operator=(const VisitedTable&);
+};
+
+#endif // _GTN_VISITED_H__
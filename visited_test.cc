@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <map>
+#include <new>
+
+#include "board.h"
+#include "visited.h"
+
+#include "gtest/gtest.h"
+
+using namespace std;
+
+static StateKey<2> MakeKey(unsigned long long a, unsigned long long b) {
+  StateKey<2> key;
+  key.w[0] = a;
+  key.w[1] = b;
+  return key;
+}
+
+TEST(TestVisited, FindAndInsert) {
+  VisitedTable<2> table;
+  EXPECT_EQ(0, table.size());
+  int value = -1;
+  EXPECT_FALSE(table.Find(MakeKey(1, 2), &value));
+  table.Insert(MakeKey(1, 2), 5);
+  ASSERT_TRUE(table.Find(MakeKey(1, 2), &value));
+  EXPECT_EQ(5, value);
+  EXPECT_FALSE(table.Find(MakeKey(2, 1), &value));
+  // Keeps the first value, as std::map::insert().
+  table.Insert(MakeKey(1, 2), 3);
+  ASSERT_TRUE(table.Find(MakeKey(1, 2), &value));
+  EXPECT_EQ(5, value);
+  table.Insert(MakeKey(2, 1), 0);
+  ASSERT_TRUE(table.Find(MakeKey(2, 1), &value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(2, table.size());
+  EXPECT_EQ(SMALL_PAGES, table.Pages());
+}
+
+TEST(TestVisited, GrowsLikeMap) {
+  // Huge pages or not, whatever the system has.
+  VisitedTable<2> table(true);
+  map<StateKey<2>, int> expected;
+  const long long initial_bytes = table.Bytes();
+  // Keys packed from the top bits, as State::Hash() makes them.
+  for (unsigned long long i = 0; i < 20000; ++i) {
+    const StateKey<2> key = MakeKey((i * 7919) << 40, i % 3);
+    table.Prefetch(key);
+    table.Insert(key, i % 100);
+    expected.insert(make_pair(key, i % 100));
+  }
+  EXPECT_EQ((long long)expected.size(), table.size());
+  EXPECT_LT(initial_bytes, table.Bytes());
+  for (map<StateKey<2>, int>::iterator it = expected.begin();
+       it != expected.end(); ++it) {
+    int value;
+    ASSERT_TRUE(table.Find(it->first, &value));
+    EXPECT_EQ(it->second, value);
+  }
+  int value;
+  EXPECT_FALSE(table.Find(MakeKey(1, 0), &value));
+  EXPECT_NE(NO_PAGES, table.Pages());
+}
+
+TEST(TestVisited, Filter) {
+  // Room for 100 keys in the filter, it grows with the slots past that.
+  VisitedTable<2> table(false, true, 100);
+  for (unsigned long long i = 0; i < 5000; ++i) {
+    table.Insert(MakeKey(i << 40, 0), i % 7);
+  }
+  int value;
+  for (unsigned long long i = 0; i < 5000; ++i) {
+    ASSERT_TRUE(table.Find(MakeKey(i << 40, 0), &value));
+    EXPECT_EQ((int)(i % 7), value);
+  }
+  EXPECT_EQ(0, table.FilterNegatives());
+  int found = 0;
+  for (unsigned long long i = 5000; i < 10000; ++i) {
+    found += table.Find(MakeKey(i << 40, 0), &value);
+  }
+  EXPECT_EQ(0, found);
+  // Nearly all new keys skip the slots.
+  EXPECT_LT(4900, table.FilterNegatives());
+}
+
+TEST(TestVisited, OutOfMemory) {
+  // Leave the table 16MB of address space to grow into.
+  long long pages = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  ASSERT_TRUE(f != NULL);
+  ASSERT_EQ(1, fscanf(f, "%lld", &pages));
+  fclose(f);
+  struct rlimit old_limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_AS, &old_limit));
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = pages * sysconf(_SC_PAGESIZE) + (16 << 20);
+  ASSERT_EQ(0, setrlimit(RLIMIT_AS, &limit));
+  VisitedTable<2> table;
+  unsigned long long inserted = 0;
+  bool thrown = false;
+  try {
+    for (; inserted < (1ULL << 24); ++inserted) {
+      table.Insert(MakeKey(inserted + 1, 0), inserted % 7);
+    }
+  } catch (const std::bad_alloc&) {
+    thrown = true;
+  }
+  ASSERT_EQ(0, setrlimit(RLIMIT_AS, &old_limit));
+  EXPECT_TRUE(thrown);
+  // What was there before the failed insert still is.
+  EXPECT_EQ((long long)inserted, table.size());
+  int value;
+  for (unsigned long long i = 0; i < inserted; ++i) {
+    ASSERT_TRUE(table.Find(MakeKey(i + 1, 0), &value));
+    EXPECT_EQ((int)(i % 7), value);
+  }
+}